@@ -2,7 +2,7 @@ module "main"
 import "std:io"
 
 main :: () i32 {
-	let i: i32 = 0;
+	let mut i: i32 = 0;
 
 	while i < 2147483647 {
 		i = i + 1;
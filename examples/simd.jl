@@ -0,0 +1,21 @@
+module "main"
+import "std:io"
+
+main :: () i32 {
+	let a: vec[i32; 4] = [1, 2, 3, 4];
+	let b: vec[i32; 4] = @splat(vec[i32; 4], 10);
+
+	let sum: vec[i32; 4] = a * b + 1;
+	let reversed: vec[i32; 4] = @shuffle(sum, [3, 2, 1, 0]);
+	let mask: vec[bool; 4] = a < 3;
+	let picked: vec[i32; 4] = @select(mask, reversed, 0);
+
+	io:print("%d\n", @extract(picked, 1));
+	io:print("%d\n", @reduce_add(sum));
+
+	let mut scaled: vec[f32; 8] = @splat(vec[f32; 8], 3);
+	scaled = @insert(scaled, 0, 1);
+	io:print("%d\n", @cast(i32, @reduce_max(scaled * scaled)));
+
+	return 0;
+}
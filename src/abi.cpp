@@ -0,0 +1,248 @@
+#include "abi.h"
+
+namespace
+{
+	enum class ArgClass
+	{
+		None,
+		Integer,
+		SSE,
+		Memory,
+	};
+
+	struct Eightbyte
+	{
+		ArgClass cls = ArgClass::None;
+		llvm::Type *scalar = nullptr; // the first scalar starting in this eightbyte
+		unsigned scalars = 0;
+	};
+
+	ArgClass merge(ArgClass a, ArgClass b)
+	{
+		if (a == b || b == ArgClass::None)
+			return a;
+
+		if (a == ArgClass::None)
+			return b;
+
+		if (a == ArgClass::Memory || b == ArgClass::Memory)
+			return ArgClass::Memory;
+
+		if (a == ArgClass::Integer || b == ArgClass::Integer)
+			return ArgClass::Integer;
+
+		return ArgClass::SSE;
+	}
+
+	// Walks the scalars of an aggregate and merges each into the eightbyte it lands in,
+	// returns false for layouts that are left to the backend, e.g. vectors inside structs
+	bool classify(const llvm::DataLayout &layout, llvm::Type *type, uint64_t offset, Eightbyte (&eightbytes)[2])
+	{
+		if (auto structType = llvm::dyn_cast<llvm::StructType>(type))
+		{
+			auto structLayout = layout.getStructLayout(structType);
+
+			for (unsigned i = 0; i < structType->getNumElements(); ++i)
+			{
+				if (!classify(layout, structType->getElementType(i), offset + structLayout->getElementOffset(i), eightbytes))
+					return false;
+			}
+
+			return true;
+		}
+
+		if (auto arrayType = llvm::dyn_cast<llvm::ArrayType>(type))
+		{
+			uint64_t elementSize = layout.getTypeAllocSize(arrayType->getElementType());
+
+			for (uint64_t i = 0; i < arrayType->getNumElements(); ++i)
+			{
+				if (!classify(layout, arrayType->getElementType(), offset + i * elementSize, eightbytes))
+					return false;
+			}
+
+			return true;
+		}
+
+		if (type->isVectorTy())
+			return false;
+
+		ArgClass cls = ArgClass::Memory;
+
+		if (type->isIntegerTy() || type->isPointerTy())
+			cls = ArgClass::Integer;
+		else if (type->isFloatTy() || type->isDoubleTy() || type->isHalfTy())
+			cls = ArgClass::SSE;
+
+		uint64_t size = layout.getTypeStoreSize(type);
+
+		// Wide scalars such as i128 cover both eightbytes and are never a single piece
+		for (uint64_t byte = offset; byte < offset + size; byte += 8)
+		{
+			Eightbyte &eightbyte = eightbytes[byte / 8];
+			eightbyte.cls = merge(eightbyte.cls, offset % layout.getABITypeAlign(type).value() ? ArgClass::Memory : cls);
+			eightbyte.scalar = eightbyte.scalar ? eightbyte.scalar : type;
+			eightbyte.scalars += size > 8 ? 2 : 1;
+		}
+
+		return true;
+	}
+
+	bool isAggregate(llvm::Type *type)
+	{
+		return type->isStructTy() || type->isArrayTy();
+	}
+
+	// Classifies an aggregate of at most two eightbytes, leaving it Direct or marking it Indirect when it cannot be coerced
+	ABIArgInfo classifyAggregate(const llvm::DataLayout &layout, llvm::Type *type, unsigned &intCount, unsigned &sseCount)
+	{
+		ABIArgInfo info;
+		info.type = type;
+
+		uint64_t size = layout.getTypeAllocSize(type);
+		Eightbyte eightbytes[2];
+
+		if (size == 0)
+			return info;
+
+		info.kind = ABIArgInfo::Indirect;
+		info.align = std::max<unsigned>(8, layout.getABITypeAlign(type).value());
+
+		if (size > 16)
+			return info;
+
+		if (!classify(layout, type, 0, eightbytes))
+		{
+			info.kind = ABIArgInfo::Direct;
+			return info;
+		}
+
+		auto &ctx = type->getContext();
+
+		for (uint64_t e = 0; e * 8 < size; ++e)
+		{
+			Eightbyte &eightbyte = eightbytes[e];
+			uint64_t bytes = std::min<uint64_t>(8, size - e * 8);
+
+			if (eightbyte.cls == ArgClass::Memory)
+			{
+				info.pieces.clear();
+				return info;
+			}
+
+			llvm::Type *piece;
+
+			if (eightbyte.cls == ArgClass::SSE)
+			{
+				++sseCount;
+
+				if (eightbyte.scalars == 1)
+					piece = eightbyte.scalar;
+				else
+					piece = llvm::FixedVectorType::get(llvm::Type::getFloatTy(ctx), bytes / 4);
+			}
+			else
+			{
+				++intCount;
+
+				if (eightbyte.scalars == 1 && layout.getTypeStoreSize(eightbyte.scalar) == bytes)
+					piece = eightbyte.scalar;
+				else
+					piece = llvm::IntegerType::get(ctx, bytes * 8);
+			}
+
+			info.pieces.push_back(piece);
+		}
+
+		info.kind = ABIArgInfo::Coerce;
+		return info;
+	}
+}
+
+llvm::Type *ABIArgInfo::coercedType(llvm::LLVMContext &ctx) const
+{
+	if (pieces.size() == 1)
+		return pieces[0];
+
+	return llvm::StructType::get(ctx, pieces);
+}
+
+FunctionABI classifyFunction(const llvm::DataLayout &layout, llvm::Type *returnType, const std::vector<llvm::Type *> &paramTypes, bool isVarArg, bool sysv)
+{
+	FunctionABI abi;
+	auto &ctx = returnType->getContext();
+
+	// Six integer and eight SSE argument registers, a hidden sret pointer takes the first integer one
+	unsigned intRegisters = 6;
+	unsigned sseRegisters = 8;
+
+	abi.ret.type = returnType;
+
+	if (sysv && isAggregate(returnType))
+	{
+		unsigned intCount = 0, sseCount = 0;
+		abi.ret = classifyAggregate(layout, returnType, intCount, sseCount);
+	}
+
+	std::vector<llvm::Type *> irParams;
+
+	if (abi.hasSret())
+	{
+		irParams.push_back(llvm::PointerType::get(ctx, 0));
+		--intRegisters;
+	}
+
+	for (auto type : paramTypes)
+	{
+		ABIArgInfo info;
+		info.type = type;
+
+		if (sysv && isAggregate(type))
+		{
+			unsigned intCount = 0, sseCount = 0;
+			info = classifyAggregate(layout, type, intCount, sseCount);
+
+			// An aggregate that does not fit in the remaining registers goes entirely on the stack
+			if (info.kind == ABIArgInfo::Coerce && (intCount > intRegisters || sseCount > sseRegisters))
+			{
+				info.kind = ABIArgInfo::Indirect;
+				info.pieces.clear();
+			}
+			else if (info.kind == ABIArgInfo::Coerce)
+			{
+				intRegisters -= intCount;
+				sseRegisters -= sseCount;
+			}
+		}
+		else if (type->isFPOrFPVectorTy() || type->isVectorTy())
+		{
+			sseRegisters -= sseRegisters > 0;
+		}
+		else
+		{
+			intRegisters -= intRegisters > 0;
+		}
+
+		info.firstArg = irParams.size();
+
+		if (info.kind == ABIArgInfo::Coerce)
+			irParams.insert(irParams.end(), info.pieces.begin(), info.pieces.end());
+		else if (info.kind == ABIArgInfo::Indirect)
+			irParams.push_back(llvm::PointerType::get(ctx, 0));
+		else
+			irParams.push_back(type);
+
+		abi.params.push_back(info);
+	}
+
+	llvm::Type *irReturn = returnType;
+
+	if (abi.hasSret())
+		irReturn = llvm::Type::getVoidTy(ctx);
+	else if (abi.ret.kind == ABIArgInfo::Coerce)
+		irReturn = abi.ret.coercedType(ctx);
+
+	abi.type = llvm::FunctionType::get(irReturn, irParams, isVarArg);
+
+	return abi;
+}
@@ -0,0 +1,61 @@
+#ifndef ABI_H
+#define ABI_H
+
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include <vector>
+
+// How one parameter or return value crosses a call at the machine level
+struct ABIArgInfo
+{
+	enum Kind
+	{
+		Direct,	  // passed as its own LLVM type
+		Coerce,	  // reinterpreted as up to two register sized pieces
+		Indirect, // passed in memory, byval for parameters and sret for returns
+	};
+
+	Kind kind = Direct;
+	llvm::Type *type = nullptr;		  // the type the source program sees
+	std::vector<llvm::Type *> pieces; // register pieces of a coerced value, in memory order
+	unsigned firstArg = 0;			  // first IR argument carrying this parameter
+	unsigned align = 0;				  // alignment of an indirect value
+
+	llvm::Type *coercedType(llvm::LLVMContext &ctx) const;
+};
+
+struct FunctionABI
+{
+	ABIArgInfo ret;
+	std::vector<ABIArgInfo> params;
+	llvm::FunctionType *type = nullptr; // the lowered signature
+
+	bool hasSret() const { return ret.kind == ABIArgInfo::Indirect; }
+
+	// Adds sret and byval attributes, works for both functions and call sites
+	template <typename T>
+	void addAttributes(T *target, llvm::LLVMContext &ctx) const
+	{
+		if (hasSret())
+		{
+			target->addParamAttr(0, llvm::Attribute::getWithStructRetType(ctx, ret.type));
+			target->addParamAttr(0, llvm::Attribute::NoAlias);
+		}
+
+		for (auto &param : params)
+		{
+			if (param.kind != ABIArgInfo::Indirect)
+				continue;
+
+			target->addParamAttr(param.firstArg, llvm::Attribute::getWithByValType(ctx, param.type));
+			target->addParamAttr(param.firstArg, llvm::Attribute::getWithAlignment(ctx, llvm::Align(param.align)));
+		}
+	}
+};
+
+// Classifies a signature following the System V x86-64 calling convention when sysv is set,
+// any other target gets its aggregates passed directly and lowered by the backend
+FunctionABI classifyFunction(const llvm::DataLayout &layout, llvm::Type *returnType, const std::vector<llvm::Type *> &paramTypes, bool isVarArg, bool sysv);
+
+#endif
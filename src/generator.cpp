@@ -5,9 +5,33 @@
 #include "llvm/TargetParser/Host.h"
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/PGOOptions.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Transforms/IPO/HotColdSplitting.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h"
 #include <llvm/Support/Process.h>
 
-Generator::Generator(Parser *parser) : parser(parser), builder(ctx), module("main", ctx) {}
+Generator::Generator(Parser *parser, CompileOptions options) : context(std::make_unique<llvm::LLVMContext>()), ctx(*context), builder(ctx), module(std::make_unique<llvm::Module>("main", ctx)), options(options), parser(parser) {}
 
 GScope::GScope(GScope *parent) : parent(parent) {}
 
@@ -32,6 +56,188 @@ std::pair<llvm::Value *, GType> GScope::getVar(std::string name)
 	return std::pair{nullptr, GType{nullptr, 0}};
 }
 
+GScope *GScope::owner(std::string name)
+{
+	for (GScope *cur = this; cur; cur = cur->parent)
+	{
+		if (cur->variables.count(name))
+			return cur;
+	}
+
+	return nullptr;
+}
+
+bool GScope::isImmutable(std::string name)
+{
+	GScope *scope = owner(name);
+	return scope && scope->immutables.count(name);
+}
+
+bool GScope::inRegister(std::string name)
+{
+	GScope *scope = owner(name);
+	return scope && scope->registers.count(name);
+}
+
+llvm::AllocaInst *Generator::createEntryAlloca(llvm::Type *type, const std::string &name)
+{
+	// Allocas outside the entry block are dynamic and are never promoted to registers
+	llvm::BasicBlock &entry = builder.GetInsertBlock()->getParent()->getEntryBlock();
+	llvm::IRBuilder<> entryBuilder(&entry, entry.begin());
+
+	return entryBuilder.CreateAlloca(type, nullptr, name);
+}
+
+// An entry block slot that is live from here until its scope ends, slots of disjoint scopes can then share stack memory
+llvm::AllocaInst *Generator::createScopedAlloca(llvm::Type *type, GScope *scope, const std::string &name)
+{
+	auto alloca = createEntryAlloca(type, name);
+
+	// As in C compilers, the markers only matter to the optimizer
+	if (options.optLevel > 0)
+	{
+		builder.CreateLifetimeStart(alloca, builder.getInt64(module->getDataLayout().getTypeAllocSize(type)));
+		scope->lifetimes.push_back(alloca);
+	}
+
+	return alloca;
+}
+
+// Paths leaving the scope through a return need no markers, the frame ends there anyway
+void Generator::endLifetimes(GScope *scope)
+{
+	if (builder.GetInsertBlock()->getTerminator())
+		return;
+
+	for (auto it = scope->lifetimes.rbegin(); it != scope->lifetimes.rend(); ++it)
+		builder.CreateLifetimeEnd(*it, builder.getInt64(module->getDataLayout().getTypeAllocSize((*it)->getAllocatedType())));
+}
+
+// Gives a register local the stack slot it skipped, once something needs its address
+llvm::AllocaInst *Generator::spill(const std::string &name, GScope *scope)
+{
+	GScope *owner = scope->owner(name);
+	auto &var = owner->variables[name];
+	auto slot = createEntryAlloca(var.second.type(ctx), name);
+
+	// The value dominates every use of the name, so it is stored right where it is defined
+	llvm::IRBuilder<> at(ctx);
+
+	if (auto phi = llvm::dyn_cast<llvm::PHINode>(var.first))
+		at.SetInsertPoint(phi->getParent(), phi->getParent()->getFirstInsertionPt());
+	else if (auto inst = llvm::dyn_cast<llvm::Instruction>(var.first))
+		at.SetInsertPoint(inst->getParent(), std::next(inst->getIterator()));
+	else
+		at.SetInsertPoint(slot->getParent(), std::next(slot->getIterator()));
+
+	at.CreateStore(var.first, slot);
+	var.first = slot;
+	owner->registers.erase(name);
+
+	return slot;
+}
+
+// Storage that can be viewed both as a value and as its coerced register pieces
+llvm::AllocaInst *Generator::createOverlayAlloca(llvm::Type *type, llvm::Type *overlay)
+{
+	auto &layout = module->getDataLayout();
+	bool overlayLarger = layout.getTypeAllocSize(overlay) > layout.getTypeAllocSize(type);
+
+	auto alloc = createEntryAlloca(overlayLarger ? overlay : type);
+	alloc->setAlignment(std::max(layout.getPrefTypeAlign(type), layout.getPrefTypeAlign(overlay)));
+
+	return alloc;
+}
+
+void Generator::storePieces(llvm::Value *ptr, const ABIArgInfo &info, std::vector<llvm::Value *> pieces)
+{
+	auto coerced = info.coercedType(ctx);
+
+	if (pieces.size() == 1)
+	{
+		builder.CreateStore(pieces[0], ptr);
+		return;
+	}
+
+	for (unsigned i = 0; i < pieces.size(); ++i)
+		builder.CreateStore(pieces[i], builder.CreateStructGEP(coerced, ptr, i));
+}
+
+// Stores an aggregate that is reloaded as its register pieces. The spare bits of an i1 store are unspecified,
+// so bools are written as whole bytes, or the optimizer may fill the rest of the piece with them
+void Generator::storeForCoercion(llvm::Value *value, llvm::Value *ptr)
+{
+	auto type = value->getType();
+
+	if (type->isIntegerTy(1))
+	{
+		builder.CreateStore(builder.CreateZExt(value, builder.getInt8Ty()), ptr);
+		return;
+	}
+
+	if (type->isStructTy() || type->isArrayTy())
+	{
+		unsigned count = type->isStructTy() ? type->getStructNumElements() : type->getArrayNumElements();
+
+		for (unsigned i = 0; i < count; ++i)
+			storeForCoercion(builder.CreateExtractValue(value, i), builder.CreateConstInBoundsGEP2_32(type, ptr, 0, i));
+
+		return;
+	}
+
+	builder.CreateStore(value, ptr);
+}
+
+std::vector<llvm::Value *> Generator::loadPieces(llvm::Value *ptr, const ABIArgInfo &info)
+{
+	auto coerced = info.coercedType(ctx);
+
+	if (info.pieces.size() == 1)
+		return {builder.CreateLoad(coerced, ptr)};
+
+	std::vector<llvm::Value *> pieces;
+
+	for (unsigned i = 0; i < info.pieces.size(); ++i)
+		pieces.push_back(builder.CreateLoad(info.pieces[i], builder.CreateStructGEP(coerced, ptr, i)));
+
+	return pieces;
+}
+
+llvm::Value *Generator::emitReturn(llvm::Value *value)
+{
+	auto func = builder.GetInsertBlock()->getParent();
+	const FunctionABI &abi = functionABIs[func];
+
+	if (abi.hasSret())
+	{
+		builder.CreateStore(value, func->getArg(0));
+		return builder.CreateRetVoid();
+	}
+
+	if (abi.ret.kind == ABIArgInfo::Coerce)
+	{
+		auto coerced = abi.ret.coercedType(ctx);
+		auto temporary = createOverlayAlloca(abi.ret.type, coerced);
+		storeForCoercion(value, temporary);
+		return builder.CreateRet(builder.CreateLoad(coerced, temporary));
+	}
+
+	return builder.CreateRet(value);
+}
+
+bool Generator::returnsIndirectly(ASTNode *expr, llvm::Type *type, GScope *scope)
+{
+	auto call = dynamic_cast<FunctionCall *>(expr);
+	auto function = call ? callee(call, scope) : nullptr;
+
+	if (!function)
+		return false;
+
+	const FunctionABI &abi = functionABIs[function];
+
+	return abi.hasSret() && abi.ret.type == type;
+}
+
 llvm::Type *GType::type(llvm::LLVMContext &ctx)
 {
 	if (depth > 0)
@@ -48,18 +254,94 @@ GType Generator::typeInfo(Type *type)
 
 	llvm::Type *ty = nullptr;
 	gType.depth = type->pointerLevel;
+	gType.isReadOnly = type->isConst;
 
 	if (auto ar = dynamic_cast<ArrayType *>(type))
 	{
 		auto elemType = typeInfo(ar->type);
 		auto arrayType = llvm::ArrayType::get(elemType.type(ctx), ar->size);
 		gType.elementType = arrayType;
+		gType.isSigned = elemType.isSigned;
+
+		return gType;
+	}
+
+	if (auto slice = dynamic_cast<SliceType *>(type))
+	{
+		auto elemType = typeInfo(slice->type);
+		gType.elementType = sliceType(elemType.type(ctx));
+		gType.isSigned = elemType.isSigned;
+		return gType;
+	}
+
+	if (auto tuple = dynamic_cast<TupleType *>(type))
+	{
+		std::vector<GType> elements;
+
+		for (auto element : tuple->types)
+			elements.push_back(typeInfo(element));
+
+		gType.elementType = tupleType(elements);
+		return gType;
+	}
+
+	if (auto vec = dynamic_cast<VectorType *>(type))
+	{
+		auto laneType = typeInfo(vec->type);
+
+		if (laneType.isPointer() || !llvm::VectorType::isValidElementType(laneType.elementType))
+		{
+			std::cerr << "invalid vector lane type, lanes must be integers, floats or bools\n";
+			exit(1);
+		}
+
+		gType.elementType = llvm::FixedVectorType::get(laneType.elementType, vec->size);
+		gType.isSigned = laneType.isSigned;
 
 		return gType;
 	}
 
 	if (auto st = dynamic_cast<StructType *>(type))
 	{
+		// A type parameter of the generic being generated stands for its type argument
+		if (auto bound = typeBindings.find(st->moduleName + ":" + st->name); bound != typeBindings.end() && st->typeArgs.empty())
+		{
+			GType argument = bound->second;
+			argument.depth += type->pointerLevel;
+
+			// T bound to ^const i64 stays read only, ^T makes a new outermost pointer
+			if (type->pointerLevel)
+				argument.isReadOnly = type->isConst;
+
+			return argument;
+		}
+
+		if (genericStructs[st->moduleName].count(st->name))
+		{
+			if (st->typeArgs.empty())
+			{
+				std::cerr << "generic struct " << st->name << " needs type arguments, e.g. " << st->name << "[i64]\n";
+				exit(1);
+			}
+
+			std::vector<GType> args;
+
+			for (auto arg : st->typeArgs)
+				args.push_back(typeInfo(arg));
+
+			gType.elementType = instantiateStruct(genericStructs[st->moduleName][st->name], args);
+			return gType;
+		}
+
+		// Enums are named like structs and stand for their backing integer
+		if (enumSymbols[st->moduleName].count(st->name))
+		{
+			GType backing = enumSymbols[st->moduleName][st->name].type;
+			gType.elementType = backing.elementType;
+			gType.isSigned = backing.isSigned;
+			return gType;
+		}
+
 		gType.elementType = structSymbols[st->moduleName][st->name].type;
 		return gType;
 	}
@@ -107,692 +389,4067 @@ GType Generator::typeInfo(Type *type)
 	}
 
 	gType.elementType = ty;
+	gType.isSigned = type->isSigned();
 
 	return gType;
 }
 
-void Generator::generateDefinitions()
+void Generator::generateStructs()
 {
+	// Enums and generic structs first, struct fields may have their types
 	for (auto fileInfo : parser->files)
 	{
 		std::string moduleName = parser->pathToModule[fileInfo.path];
 
 		for (auto node : fileInfo.nodes)
 		{
-			if (auto func = dynamic_cast<FunctionDefinition *>(node))
+			// A generic struct becomes a type per instantiation, once a type names its arguments
+			if (auto structDef = dynamic_cast<StructDefinition *>(node); structDef && !structDef->typeParams.empty())
+				genericStructs[moduleName][structDef->name] = structDef;
+
+			auto enumDef = dynamic_cast<EnumDefinition *>(node);
+
+			if (!enumDef)
+				continue;
+
+			GType type = typeInfo(enumDef->type);
+
+			if (type.isPointer() || !type.elementType || !type.elementType->isIntegerTy())
+			{
+				std::cerr << "enum " << enumDef->name << " must be backed by an integer type\n";
+				exit(1);
+			}
+
+			EnumInfo &info = enumSymbols[moduleName][enumDef->name];
+			info.type = type;
+			unsigned bits = type.elementType->getIntegerBitWidth();
+
+			for (size_t i = 0; i < enumDef->variantNames.size(); ++i)
 			{
-				std::vector<llvm::Type *> paramTypes;
+				int64_t value = enumDef->values[i];
 
-				for (auto type : func->paramTypes)
+				if (type.isSigned ? !llvm::isIntN(bits, value) : !llvm::isUIntN(bits, value))
 				{
-					paramTypes.push_back(typeInfo(type).type(ctx));
+					std::cerr << "value " << value << " of " << enumDef->name << "." << enumDef->variantNames[i] << " does not fit its backing type\n";
+					exit(1);
 				}
 
-				llvm::Type *returnType = typeInfo(func->returnType).type(ctx);
-				llvm::FunctionType *funcType = llvm::FunctionType::get(returnType, paramTypes, true);
-
-				functionSymbols[moduleName][func->name] = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, func->name, module);
+				if (!info.values.emplace(enumDef->variantNames[i], value).second)
+				{
+					std::cerr << "enum " << enumDef->name << " declares " << enumDef->variantNames[i] << " twice\n";
+					exit(1);
+				}
 			}
-			else if (auto structDef = dynamic_cast<StructDefinition *>(node))
+		}
+	}
+
+	for (auto fileInfo : parser->files)
+	{
+		std::string moduleName = parser->pathToModule[fileInfo.path];
+
+		for (auto node : fileInfo.nodes)
+		{
+			if (auto structDef = dynamic_cast<StructDefinition *>(node); structDef && structDef->typeParams.empty())
 			{
 				std::vector<llvm::Type *> memberTypes;
+				std::vector<bool> fieldSigned;
 
 				for (auto &type : structDef->fieldTypes)
 				{
 					auto ty = typeInfo(type);
 					memberTypes.push_back(ty.type(ctx));
+					fieldSigned.push_back(ty.isSigned);
 				}
 
 				std::string name = structDef->moduleName + ":" + structDef->name;
-				structSymbols[moduleName][structDef->name] = {llvm::StructType::create(ctx, memberTypes, name), structDef->fieldNames};
+				structSymbols[moduleName][structDef->name] = {llvm::StructType::create(ctx, memberTypes, name), structDef->fieldNames, fieldSigned};
 			}
 		}
 	}
 }
 
-void Generator::generate()
+// Declares every function of the program in the current module, the ones it defines get their bodies later
+void Generator::declareFunctions()
 {
-	generateDefinitions();
+	functionSymbols.clear();
 
 	for (auto fileInfo : parser->files)
 	{
-		GScope *scope = new GScope(nullptr);
-		currentFile = &fileInfo;
+		std::string moduleName = parser->pathToModule[fileInfo.path];
+
 		for (auto node : fileInfo.nodes)
 		{
-			node->codegen(scope, this);
-		}
-	}
-
-	llvm::InitializeNativeTarget();
-	llvm::InitializeNativeTargetAsmPrinter();
-
-	auto targetTriple = llvm::sys::getDefaultTargetTriple();
+			auto func = dynamic_cast<FunctionDefinition *>(node);
 
-	std::string error;
-	auto target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+			if (!func)
+				continue;
 
-	if (!target)
-	{
-		llvm::errs() << "Error: " << error << "\n";
-		return;
+			// A generic function is declared per instantiation, by the first call that needs it
+			if (!func->typeParams.empty())
+				genericFunctions[moduleName][func->name] = func;
+			else
+				declareFunction(func, func->name);
+		}
 	}
+}
 
-	auto cpu = "generic";
-	auto features = "";
-
-	llvm::TargetOptions options;
-	auto targetMachine = target->createTargetMachine(targetTriple, cpu, features, options, llvm::Reloc::PIC_);
-
-	module.setTargetTriple(targetTriple);
-	module.setDataLayout(targetMachine->createDataLayout());
-
-	auto filename = "out.o";
-	std::error_code ec;
-	llvm::raw_fd_ostream dest(filename, ec);
-
-	if (ec)
-	{
-		llvm::errs() << "Error opening file: " << ec.message() << "\n";
-		return;
-	}
+// Declares a function, or an instance of a generic one under the name that spells out its type arguments
+llvm::Function *Generator::declareFunction(FunctionDefinition *func, const std::string &name)
+{
+	std::vector<llvm::Type *> paramTypes;
 
-	auto fileType = llvm::CGFT_ObjectFile;
-	llvm::legacy::PassManager pass;
-	if (targetMachine->addPassesToEmitFile(pass, dest, nullptr, fileType))
+	for (auto type : func->paramTypes)
 	{
-		llvm::errs() << "TargetMachine can't emit a file of this type\n";
-		return;
+		paramTypes.push_back(typeInfo(type).type(ctx));
 	}
 
-	pass.run(module);
-	dest.flush();
-
-	std::string linker;
-	std::vector<std::string> args;
+	llvm::Type *returnType = typeInfo(func->returnType).type(ctx);
+	FunctionABI abi = classifyFunction(module->getDataLayout(), returnType, paramTypes, true, sysvABI);
 
-	if (llvm::Triple(llvm::sys::getProcessTriple()).isOSWindows())
-	{
-		linker = "link.exe";
-		args = {linker,
-				"/entry:_start",
-				"/subsystem:console",
-				"msvcrt.lib",
-				"/out:out.exe",
-				"out.o"};
-	}
-	else if (llvm::Triple(llvm::sys::getProcessTriple()).isOSLinux())
-	{
-		linker = "/usr/bin/ld";
+	auto function = llvm::Function::Create(abi.type, llvm::Function::ExternalLinkage, name, *module);
+	abi.addAttributes(function, ctx);
 
-		args = {linker,
-							"-o",
-							"out",
-							"out.o",
-							"-L/lib",
-							"-L/usr/lib",
-							"-lc",
-							"/usr/lib/x86_64-linux-gnu/crt1.o",
-							"/usr/lib/x86_64-linux-gnu/crti.o",
-							"-dynamic-linker",
-							"/lib64/ld-linux-x86-64.so.2",
-							"/usr/lib/x86_64-linux-gnu/crtn.o"};
-	}
-	else
+	// ^unique lets loops over several pointers vectorize without overlap checks, the inliner keeps it as
+	// scoped noalias metadata; ^const lets loads be reordered across the function's stores
+	for (size_t i = 0; i < func->paramTypes.size() && i < abi.params.size(); ++i)
 	{
-		std::cerr << "Unsupported OS\n";
-		return;
-	}
+		GType paramType = typeInfo(func->paramTypes[i]);
 
-	std::vector<llvm::StringRef> execArgs;
-	for (const auto &arg : args)
-	{
-		execArgs.push_back(arg);
-	}
+		if (!paramType.isPointer() || abi.params[i].kind != ABIArgInfo::Direct)
+			continue;
 
-	std::string errMsg;
-	int result = llvm::sys::ExecuteAndWait(linker, execArgs, std::nullopt, {}, 0, 0, &errMsg);
+		if (func->paramTypes[i]->isUnique)
+			function->addParamAttr(abi.params[i].firstArg, llvm::Attribute::NoAlias);
 
-	if (result != 0)
-	{
-		llvm::errs() << "Linking failed: " << errMsg << "\n";
+		// Also a type parameter bound to a ^const pointer
+		if (paramType.isReadOnly)
+			function->addParamAttr(abi.params[i].firstArg, llvm::Attribute::ReadOnly);
 	}
 
-	std::string llvmOutFile = "out.ll";
-
-	std::error_code errorCode;
-	llvm::raw_fd_ostream outFile(llvmOutFile, errorCode);
-
-	if (errorCode)
-	{
-		llvm::errs() << "Error opening file '" << llvmOutFile << "': " << errorCode.message() << "\n";
-		return;
-	}
+	applyAttributes(function, func->attributes);
+	functionABIs[function] = abi;
+	returnTypes[function] = typeInfo(func->returnType);
+	functionSymbols[func->moduleName][name] = function;
 
-	module.print(outFile, nullptr);
-	outFile.close();
+	return function;
 }
 
-llvm::Value *FunctionDefinition::codegen(GScope *scope, Generator *gen)
+// Instance bodies are generated between top level definitions, never in the middle of another function. Generating one
+// can declare further instances, which are generated in turn
+void Generator::generateInstances()
 {
-	if (!body)
-		return nullptr;
+	std::string currentModule = parser->pathToModule[currentFile->path];
 
-	GScope *funcScope = new GScope(scope);
-
-	llvm::Function *func = gen->functionSymbols[moduleName][name];
-	llvm::BasicBlock *entry = llvm::BasicBlock::Create(gen->module.getContext(), "entry", func);
-	gen->builder.SetInsertPoint(entry);
+	while (!pendingInstances.empty())
+	{
+		Instance instance = pendingInstances.back();
+		pendingInstances.pop_back();
 
-	unsigned i = 0;
+		auto definingModule = instance.definition->moduleName;
 
-	for (auto &arg : func->args())
-	{
-		llvm::AllocaInst *alloc = gen->builder.CreateAlloca(arg.getType(), nullptr, arg.getName());
-		gen->builder.CreateStore(&arg, alloc);
+		// With circular imports the defining module may come later, before its module level variables exist
+		if (!moduleScopes.count(definingModule))
+		{
+			for (auto &fileInfo : parser->files)
+			{
+				if (parser->pathToModule[fileInfo.path] != definingModule)
+					continue;
 
-		GType ty = gen->typeInfo(paramTypes[i]);
-		funcScope->variables[paramNames[i]] = std::pair{alloc, ty};
-		++i;
-	}
+				for (auto node : fileInfo.nodes)
+				{
+					if (dynamic_cast<GlobalDecl *>(node))
+					{
+						std::cerr << "generic " << instance.definition->name << " of module " << definingModule << " is used by " << currentModule
+								  << " before the module level variables of " << definingModule << " are generated, break the import cycle\n";
+						exit(1);
+					}
+				}
+			}
+		}
 
-	body->codegen(funcScope, gen);
+		// Another LLVM module reaches the module level variables of the defining module through declarations
+		GScope *scope = moduleScopes.count(definingModule) ? moduleScopes[definingModule] : new GScope(nullptr);
 
-	if (func->getReturnType()->isVoidTy())
-		gen->builder.CreateRetVoid();
+		if (separateModules() && definingModule != currentModule)
+			scope = importGlobals(definingModule);
 
-	return func;
-}
+		instanceDepth = instance.depth - 1;
+		enterInstance(instance.function->getName().str());
 
-llvm::Value *Block::codegen(GScope *scope, Generator *gen)
-{
-	GScope *blockScope = new GScope(scope);
+		std::swap(typeBindings, instance.bindings);
+		instance.definition->define(instance.function, scope, this);
+		std::swap(typeBindings, instance.bindings);
 
-	for (auto &node : body)
-	{
-		node->codegen(blockScope, gen);
+		instanceDepth = 0;
 	}
-
-	return nullptr;
 }
 
-llvm::Value *StringLiteral::codegen(GScope *scope, Generator *gen)
+// A generic that instantiates itself with ever growing type arguments, e.g. f[T] calling f[^T], would never finish
+void Generator::enterInstance(const std::string &name)
 {
-	return gen->builder.CreateGlobalStringPtr(value);
+	if (++instanceDepth > maxInstanceDepth)
+	{
+		std::cerr << "instantiating " << name << " exceeds the limit of " << maxInstanceDepth
+				  << " nested generic instances, a generic probably instantiates itself with ever larger type arguments\n";
+		exit(1);
+	}
 }
 
-llvm::Value *CharLiteral::codegen(GScope *scope, Generator *gen)
+void Generator::applyAttributes(llvm::Function *function, std::vector<Directive> &attributes)
 {
-	return gen->builder.getInt8(value);
-}
-
-llvm::Value *IntLiteral::codegen(GScope *scope, Generator *gen)
-{
-	return gen->builder.getInt32(value);
+	for (auto &attribute : attributes)
+	{
+		if (attribute.name == "inline")
+		{
+			function->addFnAttr(llvm::Attribute::AlwaysInline);
+		}
+		else if (attribute.name == "noinline")
+		{
+			function->addFnAttr(llvm::Attribute::NoInline);
+		}
+		else if (attribute.name == "hot")
+		{
+			function->addFnAttr(llvm::Attribute::Hot);
+		}
+		else if (attribute.name == "cold")
+		{
+			// Cold code is kept small as well as moved out of the way, like clang does
+			function->addFnAttr(llvm::Attribute::Cold);
+			function->addFnAttr(llvm::Attribute::OptimizeForSize);
+		}
+		else if (attribute.name == "flatten")
+		{
+			// LLVM has no flatten attribute, the body is flattened before the module is optimized
+			flattened.insert(function);
+		}
+		else if (attribute.name == "optimize" && attribute.args[0] == "size")
+		{
+			function->addFnAttr(llvm::Attribute::OptimizeForSize);
+			function->addFnAttr(llvm::Attribute::MinSize);
+		}
+		else if (attribute.name == "optimize" && attribute.args[0] == "speed")
+		{
+			// Trades size for speed at the call sites, the inliner accepts larger bodies of a hinted callee
+			function->addFnAttr(llvm::Attribute::InlineHint);
+		}
+		else if (attribute.name == "optimize" && attribute.args[0] == "none")
+		{
+			function->addFnAttr(llvm::Attribute::OptimizeNone);
+			function->addFnAttr(llvm::Attribute::NoInline);
+		}
+	}
 }
 
-llvm::Value *BoolLiteral::codegen(GScope *scope, Generator *gen)
+// Instruction selection and register allocation follow -O. At None each target picks its fast selector, FastISel on
+// x86 and GlobalISel on AArch64, and registers go through the fast allocator instead of the greedy one
+static llvm::CodeGenOpt::Level codeGenLevel(unsigned optLevel)
 {
-	return gen->builder.getInt1(value);
+	llvm::CodeGenOpt::Level levels[] = {llvm::CodeGenOpt::None, llvm::CodeGenOpt::Less, llvm::CodeGenOpt::Default, llvm::CodeGenOpt::Aggressive};
+	return levels[std::min(optLevel, 3u)];
 }
 
-llvm::Value *Variable::codegen(GScope *scope, Generator *gen)
+void Generator::codegen()
 {
-	auto var = scope->getVar(name);
+	llvm::InitializeNativeTarget();
+	llvm::InitializeNativeTargetAsmPrinter();
+	llvm::InitializeNativeTargetAsmParser(); // object emission assembles inline asm
 
-	if (!var.first)
+	auto targetTriple = llvm::sys::getDefaultTargetTriple();
+
+	std::string error;
+	auto target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+
+	if (!target)
 	{
-		std::cout << "Could not find variable with name: " << name << "\n";
-		return nullptr;
+		llvm::errs() << "Error: " << error << "\n";
+		exit(1);
 	}
 
-	if (gen->inReferenceContext)
-		return var.first;
+	auto cpu = "generic";
+	auto features = "";
 
-	return gen->builder.CreateLoad(var.second.type(gen->ctx), var.first);
-}
+	llvm::TargetOptions targetOptions;
+	targetMachine.reset(target->createTargetMachine(targetTriple, cpu, features, targetOptions, llvm::Reloc::PIC_, std::nullopt, codeGenLevel(options.optLevel)));
 
-llvm::Value *BinaryExpr::codegen(GScope *scope, Generator *gen)
-{
-	llvm::Value *lhsValue = lhs->codegen(scope, gen);
-	llvm::Value *rhsValue = rhs->codegen(scope, gen);
+	// Struct passing follows the C calling convention, which needs the data layout before any function is declared
+	llvm::Triple triple(targetTriple);
+	sysvABI = triple.getArch() == llvm::Triple::x86_64 && !triple.isOSWindows();
 
-	if (!lhsValue || !rhsValue)
-		return nullptr;
+	generateStructs();
 
-	auto lhsType = gen->expressionType(lhs, scope);
-	auto rhsType = gen->expressionType(rhs, scope);
+	// With ThinLTO or split modules every jolt module becomes its own LLVM module, otherwise all of them share one
+	bool perModule = options.thinLTO || options.splitModules;
 
-	switch (op.type)
-	{
-	case TOKEN_OPERATOR_PLUS:
+	for (size_t i = 0; i < parser->files.size(); ++i)
 	{
-		if (lhsType.isPointer() && rhsType.type(gen->ctx)->isIntegerTy())
+		auto fileInfo = parser->files[i];
+
+		if (perModule || i == 0)
 		{
-			return gen->builder.CreateGEP(
-				lhsType.elementType,
-				lhsValue,
-				rhsValue,
-				"ptr_add");
+			if (perModule)
+				module = std::make_unique<llvm::Module>(parser->pathToModule[fileInfo.path], ctx);
+
+			module->setTargetTriple(targetTriple);
+			module->setDataLayout(targetMachine->createDataLayout());
+			declareFunctions();
 		}
-		if (rhsType.isPointer() && lhsType.type(gen->ctx)->isIntegerTy())
+
+		GScope *scope = new GScope(nullptr);
+		currentFile = &fileInfo;
+		moduleScopes[parser->pathToModule[fileInfo.path]] = scope;
+
+		// Module level variables go first, so functions can use them wherever they are declared
+		for (auto node : fileInfo.nodes)
 		{
-			return gen->builder.CreateGEP(
-				rhsType.elementType,
-				rhsValue,
-				lhsValue,
-				"ptr_add");
+			if (dynamic_cast<GlobalDecl *>(node))
+				node->codegen(scope, this);
 		}
-		return gen->builder.CreateAdd(lhsValue, rhsValue);
-	}
-	case TOKEN_OPERATOR_MINUS:
-		return gen->builder.CreateSub(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_MUL:
-		return gen->builder.CreateMul(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_DIV:
-		return gen->builder.CreateSDiv(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_EQUAL:
-		return gen->builder.CreateICmpEQ(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_NOT_EQUAL:
-		return gen->builder.CreateICmpNE(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_LESS:
-		return gen->builder.CreateICmpSLT(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_GREATER:
-		return gen->builder.CreateICmpSGT(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_LESS_EQUAL:
-		return gen->builder.CreateICmpSLE(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_GREATER_EQUAL:
-		return gen->builder.CreateICmpSGE(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_AND:
-		return gen->builder.CreateAnd(lhsValue, rhsValue);
-	case TOKEN_OPERATOR_OR:
-		return gen->builder.CreateOr(lhsValue, rhsValue);
-	default:
-		return nullptr;
+
+		// Kept for instances of this module's generics that other LLVM modules generate
+		if (separateModules())
+		{
+			std::string moduleName = parser->pathToModule[fileInfo.path];
+
+			for (auto &[name, var] : scope->variables)
+			{
+				auto global = llvm::cast<llvm::GlobalVariable>(var.first);
+				bool keepsValue = global->isConstant() && !global->getInitializer()->needsRelocation();
+
+				// A partition may be freed before a later one needs the variable, so it is exported right away
+				if (options.partitionSize)
+				{
+					global->setLinkage(llvm::GlobalValue::ExternalLinkage);
+					global->setVisibility(llvm::GlobalValue::HiddenVisibility);
+					global->setName(moduleName + "." + name);
+				}
+
+				moduleGlobals[moduleName].push_back({name, var.second, global->isConstant(), keepsValue ? global->getInitializer() : nullptr,
+													 options.partitionSize ? nullptr : global});
+			}
+		}
+
+		for (auto node : fileInfo.nodes)
+		{
+			if (dynamic_cast<GlobalDecl *>(node))
+				continue;
+
+			node->codegen(scope, this);
+			generateInstances();
+
+			auto function = dynamic_cast<FunctionDefinition *>(node);
+
+			if (options.partitionSize && function && function->body && ++partitionFunctions == options.partitionSize)
+				flushPartition(scope);
+		}
+
+		if (perModule)
+			unitModules.push_back(std::move(module));
 	}
+
+	if (options.partitionSize)
+		flushPartition(nullptr);
 }
 
-GType Generator::expressionType(ASTNode *expr, GScope *scope)
+static std::unique_ptr<llvm::raw_fd_ostream> openOutput(const std::string &path)
 {
-	if (auto *intLit = dynamic_cast<IntLiteral *>(expr))
+	std::error_code ec;
+	auto os = std::make_unique<llvm::raw_fd_ostream>(path, ec);
+
+	if (ec)
 	{
-		return GType{llvm::Type::getInt32Ty(ctx), 0};
+		llvm::errs() << "Error opening file '" << path << "': " << ec.message() << "\n";
+		exit(1);
 	}
 
-	if (auto *stringLit = dynamic_cast<StringLiteral *>(expr))
+	return os;
+}
+
+// A temporary file with a unique name, so that builds running in the same directory do not collide
+static std::string temporaryObject()
+{
+	llvm::SmallString<128> path;
+
+	if (auto ec = llvm::sys::fs::createTemporaryFile("jolt", "o", path))
 	{
-		return GType{llvm::Type::getInt8Ty(ctx), 1};
+		llvm::errs() << "Error creating temporary file: " << ec.message() << "\n";
+		exit(1);
 	}
 
-	if (auto *var = dynamic_cast<Variable *>(expr))
+	return path.str().str();
+}
+
+bool Generator::emits(const std::string &artifact)
+{
+	return options.emit.count(artifact);
+}
+
+// The executable is named by -o, other artifacts are named after it unless -o names the only one requested
+std::string Generator::artifactPath(const std::string &extension)
+{
+	if (!options.output.empty() && options.emit.size() == 1 && !emits("link"))
+		return options.output;
+
+	return (options.output.empty() ? "out" : options.output) + extension;
+}
+
+llvm::SmallVector<char, 0> Generator::emitMachineCode(llvm::Module &target, llvm::CodeGenFileType fileType)
+{
+	llvm::SmallVector<char, 0> buffer;
+	llvm::raw_svector_ostream os(buffer);
+
+	llvm::legacy::PassManager pass;
+	if (targetMachine->addPassesToEmitFile(pass, os, nullptr, fileType))
 	{
-		return scope->getVar(var->name).second;
+		llvm::errs() << "TargetMachine can't emit a file of this type\n";
+		exit(1);
 	}
 
-	if (auto *unary = dynamic_cast<UnaryExpr *>(expr))
+	pass.run(target);
+	return buffer;
+}
+
+// Optimizes and emits the functions generated so far, then frees their IR. The next partition, if any, starts with
+// declarations of every function and of the module level variables of the jolt module being generated
+void Generator::flushPartition(GScope *fileScope)
+{
+	struct GlobalCopy
 	{
-		GType subType = expressionType(unary->expr, scope);
-		if (unary->op.type == TOKEN_POINTER)
-		{
-			return GType{subType.elementType, subType.depth - 1};
-		}
-		if (unary->op.type == TOKEN_REFERENCE)
+		std::string name;
+		llvm::Type *type;
+		bool isConstant;
+		llvm::Constant *value; // kept so the next partition can still fold it, unless it points into this one
+	};
+
+	// The last flush runs after every file was generated, with no jolt module left to name
+	std::string moduleName = fileScope ? parser->pathToModule[currentFile->path] : "";
+	std::vector<GlobalCopy> globals;
+
+	// A variable is defined by the partition that generated it and only declared by later ones, which link to it.
+	// What they need is copied now, the optimizer may delete the declarations this partition does not use
+	if (fileScope)
+	{
+		for (auto &[name, var] : fileScope->variables)
 		{
-			return GType{subType.elementType, subType.depth + 1};
+			auto global = llvm::dyn_cast<llvm::GlobalVariable>(var.first);
+
+			if (!global)
+				continue;
+
+			if (global->hasLocalLinkage())
+			{
+				global->setLinkage(llvm::GlobalValue::ExternalLinkage);
+				global->setVisibility(llvm::GlobalValue::HiddenVisibility);
+				global->setName(moduleName + "." + name);
+			}
+
+			bool keepsValue = global->isConstant() && global->hasInitializer() && !global->getInitializer()->needsRelocation();
+			globals.push_back({name, global->getValueType(), global->isConstant(), keepsValue ? global->getInitializer() : nullptr});
 		}
-		return subType;
 	}
 
-	if (auto *binary = dynamic_cast<BinaryExpr *>(expr))
+	optimize(*module);
+
+	auto object = emitMachineCode(*module, llvm::CGFT_ObjectFile);
+	partitionObjects.push_back(temporaryObject());
+	*openOutput(partitionObjects.back()) << llvm::StringRef(object.data(), object.size());
+
+	partitionFunctions = 0;
+
+	// Everything keyed by the functions about to be freed goes with them
+	functionABIs.clear();
+	returnTypes.clear();
+	trapBlocks.clear();
+	flattened.clear();
+
+	if (!fileScope)
+	{
+		module.reset();
+		return;
+	}
+
+	auto next = std::make_unique<llvm::Module>(moduleName + "." + std::to_string(partitionObjects.size()), ctx);
+	next->setTargetTriple(module->getTargetTriple());
+	next->setDataLayout(module->getDataLayout());
+
+	for (auto &global : globals)
 	{
-		GType lhsType = expressionType(binary->lhs, scope);
-		GType rhsType = expressionType(binary->rhs, scope);
-		return lhsType; // TODO: Fix this
+		auto linkage = global.value ? llvm::GlobalValue::AvailableExternallyLinkage : llvm::GlobalValue::ExternalLinkage;
+		auto declaration = new llvm::GlobalVariable(*next, global.type, global.isConstant, linkage, global.value, moduleName + "." + global.name);
+
+		declaration->setVisibility(llvm::GlobalValue::HiddenVisibility);
+		fileScope->variables[global.name].first = declaration;
 	}
 
-	return GType{llvm::Type::getInt32Ty(ctx), 0};
+	module = std::move(next);
+	declareFunctions();
 }
 
-llvm::Value *Cast::codegen(GScope *scope, Generator *gen)
+// Finds compiler-rt's profile runtime for a target in the layouts clang installs it with: lib/<triple>/ with a plain name,
+// or lib/<os>/ with the architecture in the name
+static std::string profileRuntime(const llvm::Triple &triple)
 {
-	auto val = expr->codegen(scope, gen);
+	std::string version = std::to_string(LLVM_VERSION_MAJOR);
+	std::vector<std::string> resourceDirs = {
+		"/usr/lib/llvm-" + version + "/lib/clang/" + version,
+		"/usr/lib/clang/" + version,
+		"/usr/local/lib/clang/" + version,
+	};
 
-	GType targetGType = gen->typeInfo(type);
-	GType sourceGType = gen->expressionType(expr, scope);
-
-	auto targetType = targetGType.type(gen->ctx);
-	auto sourceType = sourceGType.type(gen->ctx);
+	// Distributions name the per-target directory with the vendor they build for
+	std::vector<std::string> libraries;
 
-	if (sourceType->isIntegerTy() && targetType->isIntegerTy())
+	for (auto vendor : {triple.getVendor(), llvm::Triple::UnknownVendor, llvm::Triple::PC})
 	{
-		unsigned srcBits = sourceType->getIntegerBitWidth();
-		unsigned dstBits = targetType->getIntegerBitWidth();
+		llvm::Triple target(triple);
+		target.setVendor(vendor);
+		std::string library = "/lib/" + target.str() + "/libclang_rt.profile.a";
 
-		if (srcBits == dstBits)
+		if (std::find(libraries.begin(), libraries.end(), library) == libraries.end())
+			libraries.push_back(library);
+	}
+
+	if (triple.isOSDarwin())
+		libraries.push_back("/lib/darwin/libclang_rt.profile_osx.a");
+	else
+		libraries.push_back("/lib/" + triple.getOSTypeName(triple.getOS()).str() + "/libclang_rt.profile-" + triple.getArchName().str() + ".a");
+
+	for (auto &dir : resourceDirs)
+	{
+		for (auto &library : libraries)
 		{
-			return val;
+			if (llvm::sys::fs::exists(dir + library))
+				return dir + library;
 		}
-		else if (srcBits < dstBits)
+	}
+
+	std::cerr << "Could not find the clang profile runtime for " << triple.str() << ", looked for";
+
+	for (auto &library : libraries)
+		std::cerr << " " << library.substr(1);
+
+	std::cerr << " in the clang " << version << " resource directories. Pass it with -fprofile-runtime=<path>\n";
+	exit(1);
+}
+
+// The exit status of the compiler, non-zero when linking failed
+int Generator::generate()
+{
+	if (options.partitionSize && (emits("obj") || emits("asm") || emits("llvm-ir") || emits("bc")))
+	{
+		std::cerr << "-fpartition-size only links an executable, partitions are freed as soon as they are emitted\n";
+		exit(1);
+	}
+
+	// Looked up before any code is generated, a missing runtime would otherwise only show at the very end
+	if (options.profileGenerate && emits("link") && options.profileRuntime.empty())
+		options.profileRuntime = profileRuntime(llvm::Triple(llvm::sys::getDefaultTargetTriple()));
+
+	codegen();
+
+	// Every partition was emitted during code generation
+	if (options.partitionSize)
+	{
+		bool linked = link(partitionObjects);
+
+		for (auto &object : partitionObjects)
+			llvm::sys::fs::remove(object);
+
+		return linked ? 0 : 1;
+	}
+
+	if (options.thinLTO)
+	{
+		if (emits("obj") || emits("asm"))
 		{
-			if (type->isSigned())
-			{
-				return gen->builder.CreateSExt(val, targetType, "sext");
-			}
-			else
-			{
-				return gen->builder.CreateZExt(val, targetType, "zext");
-			}
+			std::cerr << "--emit=obj and --emit=asm are not available with -flto=thin, code is only generated at link time\n";
+			exit(1);
 		}
-		else
+
+		auto objects = thinLink();
+		bool linked = !emits("link") || link(objects);
+
+		for (auto &object : objects)
+			llvm::sys::fs::remove(object);
+
+		return linked ? 0 : 1;
+	}
+
+	if (options.splitModules)
+	{
+		auto objects = compileUnits();
+		bool linked = !emits("link") || link(objects);
+
+		if (!emits("obj"))
 		{
-			return gen->builder.CreateTrunc(val, targetType, "trunc");
+			for (auto &object : objects)
+				llvm::sys::fs::remove(object);
 		}
+
+		return linked ? 0 : 1;
 	}
 
-	return nullptr;
-}
+	optimize(*module);
 
-llvm::Value *While::codegen(GScope *scope, Generator *gen)
-{
-	auto func = gen->builder.GetInsertBlock()->getParent();
+	if (emits("llvm-ir"))
+		module->print(*openOutput(artifactPath(".ll")), nullptr);
 
-	GScope *whileScope = new GScope(scope);
+	if (emits("bc"))
+		llvm::WriteBitcodeToFile(*module, *openOutput(artifactPath(".bc")));
 
-	auto condBlock = llvm::BasicBlock::Create(gen->ctx, "cond", func);
-	auto bodyBlock = llvm::BasicBlock::Create(gen->ctx, "body", func);
-	auto mergeBlock = llvm::BasicBlock::Create(gen->ctx, "merge", func);
+	// Code generation rewrites the module, so assembly is produced from a copy when an object is needed too
+	if (emits("asm"))
+	{
+		auto copy = emits("obj") || emits("link") ? llvm::CloneModule(*module) : nullptr;
+		auto assembly = emitMachineCode(copy ? *copy : *module, llvm::CGFT_AssemblyFile);
+		*openOutput(artifactPath(".s")) << llvm::StringRef(assembly.data(), assembly.size());
+	}
 
-	gen->builder.CreateBr(condBlock);
-	gen->builder.SetInsertPoint(condBlock);
+	if (!emits("obj") && !emits("link"))
+		return 0;
 
-	auto cond = condition->codegen(whileScope, gen);
-	gen->builder.CreateCondBr(cond, bodyBlock, mergeBlock);
+	auto object = emitMachineCode(*module, llvm::CGFT_ObjectFile);
+	llvm::StringRef objectData(object.data(), object.size());
 
-	gen->builder.SetInsertPoint(bodyBlock);
+	if (emits("obj"))
+		*openOutput(artifactPath(".o")) << objectData;
 
-	body->codegen(whileScope, gen);
-	gen->builder.CreateBr(condBlock);
+	if (emits("link"))
+	{
+		std::string path = emits("obj") ? artifactPath(".o") : temporaryObject();
 
-	gen->builder.SetInsertPoint(mergeBlock);
+		if (!emits("obj"))
+			*openOutput(path) << objectData;
 
-	return nullptr;
+		bool linked = link({path});
+
+		if (!emits("obj"))
+			llvm::sys::fs::remove(path);
+
+		return linked ? 0 : 1;
+	}
+
+	return 0;
 }
 
-llvm::Value *Conditional::codegen(GScope *scope, Generator *gen)
+// Functions worth a copy in the modules that call them: #inline ones, and when optimizing small ones.
+// A copy may only use constant module state, a duplicate of a mutable global would be a different variable
+static bool isInlineCandidate(const llvm::Function &function, unsigned optLevel)
 {
+	if (function.isDeclaration() || function.hasLocalLinkage() || function.getName() == "main")
+		return false;
 
-	auto func = gen->builder.GetInsertBlock()->getParent();
-	auto mergeBB = llvm::BasicBlock::Create(gen->ctx, "if.end", func);
+	if (function.hasFnAttribute(llvm::Attribute::NoInline) || function.hasFnAttribute(llvm::Attribute::OptimizeNone))
+		return false;
 
-	for (auto &condition : conditions)
+	if (!function.hasFnAttribute(llvm::Attribute::AlwaysInline) && (optLevel == 0 || function.getInstructionCount() > 32))
+		return false;
+
+	std::function<bool(const llvm::Value *)> usesLocalState = [&](const llvm::Value *value)
 	{
-		auto *condBB = llvm::BasicBlock::Create(gen->ctx, "if.cond", func);
-		auto *thenBB = llvm::BasicBlock::Create(gen->ctx, "if.then", func);
-		auto *elseBB = llvm::BasicBlock::Create(gen->ctx, "if.else", func);
-		gen->builder.CreateBr(condBB);
-		gen->builder.SetInsertPoint(condBB);
+		if (auto global = llvm::dyn_cast<llvm::GlobalVariable>(value))
+			return global->hasLocalLinkage() && !global->isConstant();
 
-		if (condition.first)
+		if (auto callee = llvm::dyn_cast<llvm::Function>(value))
+			return callee->hasLocalLinkage();
+
+		if (auto constant = llvm::dyn_cast<llvm::ConstantExpr>(value))
+			return std::any_of(constant->op_begin(), constant->op_end(), [&](const llvm::Use &op)
+							   { return usesLocalState(op.get()); });
+
+		return false;
+	};
+
+	for (auto &inst : llvm::instructions(function))
+	{
+		for (auto &op : inst.operands())
 		{
-			GScope *condScope = new GScope(scope);
-			auto *condValue = condition.first->codegen(condScope, gen);
-			if (!condValue)
-				return nullptr;
+			if (usesLocalState(op.get()))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// Copies the candidates this unit calls from the other units as available_externally definitions. The optimizer
+// can inline them, and drops whatever copies are left, since each is still emitted by its own module
+void Generator::importInlineCandidates(llvm::Module &unit)
+{
+	for (auto &source : unitModules)
+	{
+		if (source.get() == &unit)
+			continue;
+
+		std::set<const llvm::GlobalValue *> imports;
+
+		for (auto &function : *source)
+		{
+			auto declaration = unit.getFunction(function.getName());
+
+			if (declaration && declaration->isDeclaration() && !declaration->use_empty() && isInlineCandidate(function, options.optLevel))
+				imports.insert(&function);
+		}
+
+		if (imports.empty())
+			continue;
+
+		// Everything else becomes a declaration, except the private constants such as string literals the copies use
+		llvm::ValueToValueMapTy map;
+		auto copy = llvm::CloneModule(*source, map, [&](const llvm::GlobalValue *global)
+									  { return imports.count(global) || (global->hasLocalLinkage() && llvm::isa<llvm::GlobalVariable>(global) && llvm::cast<llvm::GlobalVariable>(global)->isConstant()); });
+
+		for (auto function : imports)
+			llvm::cast<llvm::Function>(map[function])->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+
+		if (llvm::Linker::linkModules(unit, std::move(copy), llvm::Linker::Flags::LinkOnlyNeeded))
+		{
+			std::cerr << "Failed to import functions into module " << unit.getModuleIdentifier() << "\n";
+			exit(1);
+		}
+	}
+}
+
+// Every jolt module is optimized and emitted on its own, after taking copies of the small functions it calls. An object
+// only depends on the module at that point and on the options that shape code generation, so objects are cached by
+// their hash and a rebuild only optimizes and emits the modules that changed
+std::vector<std::string> Generator::compileUnits()
+{
+	for (auto &unit : unitModules)
+		importInlineCandidates(*unit);
+
+	std::vector<std::string> objects(unitModules.size());
+
+	auto addBuffer = [&](unsigned task, const llvm::Twine &, std::unique_ptr<llvm::MemoryBuffer> buffer)
+	{
+		*openOutput(objects[task]) << buffer->getBuffer();
+	};
+
+	auto cache = llvm::localCache("SplitModules", "split", ".jolt-cache", addBuffer);
+
+	if (!cache)
+	{
+		llvm::errs() << "Error: " << llvm::toString(cache.takeError()) << "\n";
+		exit(1);
+	}
+
+	auto cacheKey = [&](llvm::Module &unit)
+	{
+		llvm::SmallVector<char, 0> bitcode;
+		llvm::raw_svector_ostream os(bitcode);
+		llvm::WriteBitcodeToFile(unit, os);
+
+		llvm::SHA1 hash;
+		hash.update(llvm::StringRef(bitcode.data(), bitcode.size()));
+		hash.update("-O" + std::to_string(options.optLevel) + (options.profileGenerate ? " -fprofile-generate" : ""));
+
+		if (!options.profileUse.empty())
+		{
+			if (auto profile = llvm::MemoryBuffer::getFile(options.profileUse))
+				hash.update((*profile)->getBuffer());
+		}
+
+		return llvm::toHex(hash.final());
+	};
+
+	// The other artifacts are produced from the optimized module, which the cache does not keep
+	bool objectsOnly = !emits("llvm-ir") && !emits("bc") && !emits("asm");
+
+	for (unsigned task = 0; task < unitModules.size(); ++task)
+	{
+		auto &unit = unitModules[task];
+		std::string name = unit->getModuleIdentifier();
+
+		if (emits("obj") || emits("link"))
+			objects[task] = emits("obj") ? name + ".o" : temporaryObject();
+
+		if (objectsOnly)
+		{
+			auto stream = (*cache)(task, cacheKey(*unit), name);
+
+			if (!stream)
+			{
+				llvm::errs() << "Error: " << llvm::toString(stream.takeError()) << "\n";
+				exit(1);
+			}
+
+			// On a hit the cache has already handed the object to addBuffer
+			if (!*stream)
+				continue;
+
+			optimize(*unit);
+			auto object = emitMachineCode(*unit, llvm::CGFT_ObjectFile);
+			auto entry = (*stream)(task, name);
+
+			if (!entry)
+			{
+				llvm::errs() << "Error: " << llvm::toString(entry.takeError()) << "\n";
+				exit(1);
+			}
+
+			// The entry is committed to the cache, and passed to addBuffer, when its stream is closed
+			*(*entry)->OS << llvm::StringRef(object.data(), object.size());
+			continue;
+		}
+
+		optimize(*unit);
+
+		if (emits("llvm-ir"))
+			unit->print(*openOutput(name + ".ll"), nullptr);
+
+		if (emits("bc"))
+			llvm::WriteBitcodeToFile(*unit, *openOutput(name + ".bc"));
+
+		if (emits("asm"))
+		{
+			auto copy = emits("obj") || emits("link") ? llvm::CloneModule(*unit) : nullptr;
+			auto assembly = emitMachineCode(copy ? *copy : *unit, llvm::CGFT_AssemblyFile);
+			*openOutput(name + ".s") << llvm::StringRef(assembly.data(), assembly.size());
+		}
+
+		if (!emits("obj") && !emits("link"))
+			continue;
+
+		auto object = emitMachineCode(*unit, llvm::CGFT_ObjectFile);
+		*openOutput(objects[task]) << llvm::StringRef(object.data(), object.size());
+	}
+
+	objects.erase(std::remove(objects.begin(), objects.end(), ""), objects.end());
+	return objects;
+}
+
+bool Generator::link(const std::vector<std::string> &objects)
+{
+	std::string executable = options.output.empty() ? "out" : options.output;
+	std::string linker;
+	std::vector<std::string> args;
+
+	if (llvm::Triple(llvm::sys::getProcessTriple()).isOSWindows())
+	{
+		linker = "link.exe";
+		args = {linker,
+				"/entry:_start",
+				"/subsystem:console",
+				"msvcrt.lib",
+				"/out:" + executable + ".exe"};
+	}
+	else if (auto driver = llvm::sys::findProgramByName("cc"); driver && llvm::Triple(llvm::sys::getProcessTriple()).isOSLinux())
+	{
+		// The C compiler driver knows where the C runtime startup files and the dynamic linker live
+		linker = *driver;
+		args = {linker, "-o", executable};
+	}
+	else if (llvm::Triple(llvm::sys::getProcessTriple()).isOSLinux())
+	{
+		linker = "/usr/bin/ld";
+
+		args = {linker,
+							"-o",
+							executable,
+							"-L/lib",
+							"-L/usr/lib",
+							"-lc",
+							"/usr/lib/x86_64-linux-gnu/crt1.o",
+							"/usr/lib/x86_64-linux-gnu/crti.o",
+							"-dynamic-linker",
+							"/lib64/ld-linux-x86-64.so.2",
+							"/usr/lib/x86_64-linux-gnu/crtn.o"};
+	}
+	else
+	{
+		std::cerr << "Unsupported OS\n";
+		return false;
+	}
+
+	args.insert(args.end(), objects.begin(), objects.end());
+
+	// The instrumented program writes its counts through compiler-rt's profile runtime
+	if (options.profileGenerate)
+	{
+		args.push_back("-u");
+		args.push_back("__llvm_profile_runtime");
+		args.push_back(options.profileRuntime);
+	}
+
+	std::vector<llvm::StringRef> execArgs;
+	for (const auto &arg : args)
+	{
+		execArgs.push_back(arg);
+	}
+
+	std::string errMsg;
+	int result = llvm::sys::ExecuteAndWait(linker, execArgs, std::nullopt, {}, 0, 0, &errMsg);
+
+	if (result != 0)
+	{
+		llvm::errs() << "Linking failed" << (errMsg.empty() ? "" : ": " + errMsg) << "\n";
+		return false;
+	}
+
+	return true;
+}
+
+int Generator::run(const std::vector<std::string> &args)
+{
+	if (options.profileGenerate)
+	{
+		std::cerr << "-fprofile-generate needs a linked executable and cannot be used with run\n";
+		exit(1);
+	}
+
+	// The JIT links in memory and keeps the whole program, so it is compiled as a single module
+	options.thinLTO = false;
+	options.splitModules = false;
+	options.partitionSize = 0;
+
+	codegen();
+	optimize(*module);
+
+	// The JIT compiles for the same triple and generic CPU as the object file pipeline
+	auto jit = llvm::orc::LLJITBuilder()
+				   .setJITTargetMachineBuilder(llvm::orc::JITTargetMachineBuilder(llvm::Triple(module->getTargetTriple())).setCodeGenOptLevel(codeGenLevel(options.optLevel)))
+				   .create();
+
+	if (!jit)
+	{
+		llvm::errs() << "Error: " << llvm::toString(jit.takeError()) << "\n";
+		exit(1);
+	}
+
+	// libc and everything else the compiler process links against resolves from the host
+	auto hostSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+
+	if (!hostSymbols)
+	{
+		llvm::errs() << "Error: " << llvm::toString(hostSymbols.takeError()) << "\n";
+		exit(1);
+	}
+
+	(*jit)->getMainJITDylib().addGenerator(std::move(*hostSymbols));
+
+	if (auto err = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), llvm::orc::ThreadSafeContext(std::move(context)))))
+	{
+		llvm::errs() << "Error: " << llvm::toString(std::move(err)) << "\n";
+		exit(1);
+	}
+
+	auto mainSymbol = (*jit)->lookup("main");
+
+	if (!mainSymbol)
+	{
+		llvm::errs() << "Error: " << llvm::toString(mainSymbol.takeError()) << "\n";
+		exit(1);
+	}
+
+	auto mainFunction = mainSymbol->toPtr<int (*)(int, char **)>();
+
+	return llvm::orc::runAsMain(mainFunction, llvm::ArrayRef<std::string>(args).drop_front(), llvm::StringRef(args[0]));
+}
+
+// Interval of values an index expression can take, as far as loop bounds and constants tell. Every step is evaluated at
+// the width and signedness the code computes it in, and a step that may wrap gives up
+static bool indexRange(ASTNode *expr, GType type, GScope *scope, Generator *gen, int64_t &min, int64_t &max)
+{
+	if (type.isPointer() || !type.elementType->isIntegerTy() || type.elementType->getIntegerBitWidth() > 64)
+		return false;
+
+	unsigned bits = type.elementType->getIntegerBitWidth();
+	int64_t lowest = type.isSigned ? llvm::minIntN(bits) : 0;
+	int64_t highest = type.isSigned ? llvm::maxIntN(bits) : (int64_t)std::min<uint64_t>(llvm::maxUIntN(bits), INT64_MAX);
+
+	if (auto intLit = dynamic_cast<IntLiteral *>(expr))
+	{
+		min = max = intLit->value;
+	}
+	else if (auto var = dynamic_cast<Variable *>(expr))
+	{
+		GScope *owner = scope->owner(var->name);
+
+		if (!owner || !owner->ranges.count(var->name))
+			return false;
+
+		std::tie(min, max) = owner->ranges[var->name];
+	}
+	else if (auto binary = dynamic_cast<BinaryExpr *>(expr))
+	{
+		GType operand = gen->operandType(binary, scope);
+		int64_t lhsMin, lhsMax, rhsMin, rhsMax;
+
+		if (!indexRange(binary->lhs, operand, scope, gen, lhsMin, lhsMax) || !indexRange(binary->rhs, operand, scope, gen, rhsMin, rhsMax))
+			return false;
+
+		bool overflow;
+
+		switch (binary->op.type)
+		{
+		case TOKEN_OPERATOR_PLUS:
+			overflow = llvm::AddOverflow(lhsMin, rhsMin, min) | llvm::AddOverflow(lhsMax, rhsMax, max);
+			break;
+		case TOKEN_OPERATOR_MINUS:
+			overflow = llvm::SubOverflow(lhsMin, rhsMax, min) | llvm::SubOverflow(lhsMax, rhsMin, max);
+			break;
+		case TOKEN_OPERATOR_MUL:
+			if (lhsMin < 0 || rhsMin < 0)
+				return false;
+			overflow = llvm::MulOverflow(lhsMin, rhsMin, min) | llvm::MulOverflow(lhsMax, rhsMax, max);
+			break;
+		default:
+			return false;
+		}
+
+		if (overflow)
+			return false;
+	}
+	else
+	{
+		return false;
+	}
+
+	return min >= lowest && max <= highest;
+}
+
+void Generator::boundsCheck(ASTNode *indexExpr, llvm::Value *index, llvm::Value *length, GScope *scope)
+{
+	if (!options.boundsCheck)
+		return;
+
+	auto constantLength = llvm::dyn_cast<llvm::ConstantInt>(length);
+
+	if (constantLength)
+	{
+		uint64_t size = constantLength->getZExtValue();
+		int64_t min, max;
+
+		if (indexRange(indexExpr, expressionType(indexExpr, scope), scope, this, min, max) && min >= 0 && (uint64_t)max < size)
+			return;
+
+		if (auto constant = llvm::dyn_cast<llvm::ConstantInt>(index))
+		{
+			if (constant->getSExtValue() >= 0 && (uint64_t)constant->getSExtValue() < size)
+				return;
+
+			std::cerr << "index " << constant->getSExtValue() << " is out of bounds for array of size " << size << "\n";
+			exit(1);
+		}
+	}
+
+	// Negative indexes wrap around to huge unsigned values, so one unsigned compare covers both ends
+	auto wideIndex = builder.CreateSExtOrTrunc(index, builder.getInt64Ty());
+	trapUnless(builder.CreateICmpULT(wideIndex, length, "bounds.ok"));
+}
+
+void Generator::trapUnless(llvm::Value *condition)
+{
+	auto func = builder.GetInsertBlock()->getParent();
+	auto &trapBlock = trapBlocks[func];
+
+	// One shared trap per function keeps the checks to a compare and a branch each
+	if (!trapBlock)
+	{
+		trapBlock = llvm::BasicBlock::Create(ctx, "bounds.trap", func);
+		llvm::IRBuilder<> trapBuilder(trapBlock);
+		trapBuilder.CreateIntrinsic(llvm::Intrinsic::trap, {}, {});
+		trapBuilder.CreateUnreachable();
+	}
+
+	auto okBlock = llvm::BasicBlock::Create(ctx, "bounds.cont", func);
+
+	builder.CreateCondBr(condition, okBlock, trapBlock, llvm::MDBuilder(ctx).createBranchWeights(1 << 20, 1));
+	builder.SetInsertPoint(okBlock);
+}
+
+llvm::MDNode *Generator::branchWeights(ASTNode *condition)
+{
+	auto hint = dynamic_cast<Builtin *>(condition);
+
+	if (!hint || (hint->name != "likely" && hint->name != "unlikely"))
+		return nullptr;
+
+	// Same weights LowerExpectIntrinsic would use, applied directly so they also hold at -O0
+	llvm::MDBuilder weights(ctx);
+
+	return hint->name == "likely" ? weights.createBranchWeights(2000, 1) : weights.createBranchWeights(1, 2000);
+}
+
+// Inlines every call a #flatten body makes, then the calls the inlined bodies bring along, as GCC's flatten does. A
+// callee already inlined on the way to a call is left alone, so recursion ends, and so are bodies this module lacks
+static void flatten(llvm::Function &function)
+{
+	std::vector<std::pair<llvm::CallBase *, std::vector<llvm::Function *>>> calls;
+
+	for (auto &inst : llvm::instructions(function))
+	{
+		if (auto call = llvm::dyn_cast<llvm::CallBase>(&inst))
+			calls.push_back({call, {&function}});
+	}
+
+	while (!calls.empty())
+	{
+		auto [call, history] = calls.back();
+		calls.pop_back();
+
+		auto callee = call->getCalledFunction();
+
+		if (!callee || callee->isDeclaration() || call->isMustTailCall() || callee->hasFnAttribute(llvm::Attribute::NoInline) ||
+			std::count(history.begin(), history.end(), callee))
+			continue;
+
+		llvm::InlineFunctionInfo info;
+
+		if (!llvm::InlineFunction(*call, info).isSuccess())
+			continue;
+
+		history.push_back(callee);
+
+		for (auto inlined : info.InlinedCallSites)
+			calls.push_back({inlined, history});
+	}
+}
+
+void Generator::optimize(llvm::Module &target)
+{
+	// In module order, so that the result does not depend on where the functions were allocated
+	for (auto &function : target)
+	{
+		if (flattened.count(&function))
+			flatten(function);
+	}
+
+	llvm::LoopAnalysisManager lam;
+	llvm::FunctionAnalysisManager fam;
+	llvm::CGSCCAnalysisManager cgam;
+	llvm::ModuleAnalysisManager mam;
+
+	// Instrumentation and profile annotation run inside the standard pipelines, at their usual positions
+	std::optional<llvm::PGOOptions> pgo;
+
+	if (options.profileGenerate)
+		pgo = llvm::PGOOptions("default_%m.profraw", "", "", "", llvm::vfs::getRealFileSystem(), llvm::PGOOptions::IRInstr);
+	else if (!options.profileUse.empty())
+		pgo = llvm::PGOOptions(options.profileUse, "", "", "", llvm::vfs::getRealFileSystem(), llvm::PGOOptions::IRUse);
+
+	llvm::PassBuilder passBuilder(targetMachine.get(), llvm::PipelineTuningOptions(), pgo);
+
+	// With real counts, cold paths are worth outlining out of hot functions
+	if (!options.profileUse.empty() && !options.thinLTO)
+	{
+		passBuilder.registerOptimizerLastEPCallback([](llvm::ModulePassManager &mpm, llvm::OptimizationLevel)
+													{ mpm.addPass(llvm::HotColdSplittingPass()); });
+	}
+
+	passBuilder.registerModuleAnalyses(mam);
+	passBuilder.registerCGSCCAnalyses(cgam);
+	passBuilder.registerFunctionAnalyses(fam);
+	passBuilder.registerLoopAnalyses(lam);
+	passBuilder.crossRegisterProxies(lam, fam, cgam, mam);
+
+	llvm::OptimizationLevel levels[] = {
+		llvm::OptimizationLevel::O0,
+		llvm::OptimizationLevel::O1,
+		llvm::OptimizationLevel::O2,
+		llvm::OptimizationLevel::O3};
+
+	llvm::ModulePassManager modulePasses;
+
+	// The O0 pipeline still runs the always inliner so that #inline is honored.
+	// Under ThinLTO only the pre-link half runs here, the rest happens after cross-module importing
+	if (options.optLevel == 0)
+		modulePasses = passBuilder.buildO0DefaultPipeline(levels[0], options.thinLTO);
+	else if (options.thinLTO)
+		modulePasses = passBuilder.buildThinLTOPreLinkDefaultPipeline(levels[options.optLevel]);
+	else
+		modulePasses = passBuilder.buildPerModuleDefaultPipeline(levels[options.optLevel]);
+
+	modulePasses.run(target, mam);
+}
+
+std::vector<std::string> Generator::thinLink()
+{
+	std::vector<std::unique_ptr<llvm::MemoryBuffer>> bitcode;
+	std::set<std::string> joltSymbols; // what the program defines, before instrumentation adds symbols for its runtime
+
+	// Modules are handed to the thin link as in-memory bitcode with their summaries
+	for (auto &thinModule : unitModules)
+	{
+		for (auto &global : thinModule->global_values())
+			joltSymbols.insert(global.getName().str());
+
+		optimize(*thinModule);
+
+		llvm::ProfileSummaryInfo profileSummary(*thinModule);
+		auto index = llvm::buildModuleSummaryIndex(*thinModule, nullptr, &profileSummary);
+
+		llvm::SmallVector<char, 0> buffer;
+		llvm::raw_svector_ostream os(buffer);
+		llvm::WriteBitcodeToFile(*thinModule, os, false, &index, true);
+
+		std::string name = thinModule->getModuleIdentifier();
+		llvm::StringRef data(buffer.data(), buffer.size());
+
+		if (emits("bc"))
+			*openOutput(name + ".bc") << data;
+
+		if (emits("llvm-ir"))
+			thinModule->print(*openOutput(name + ".ll"), nullptr);
+
+		bitcode.push_back(llvm::MemoryBuffer::getMemBufferCopy(data, name));
+	}
+
+	llvm::lto::Config config;
+	config.CPU = "generic";
+	config.RelocModel = llvm::Reloc::PIC_;
+	config.OptLevel = options.optLevel;
+	config.CGOptLevel = codeGenLevel(options.optLevel);
+
+	llvm::lto::LTO lto(std::move(config), llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency()));
+
+	for (auto &buffer : bitcode)
+	{
+		auto input = llvm::lto::InputFile::create(buffer->getMemBufferRef());
+
+		if (!input)
+		{
+			llvm::errs() << "Error: " << llvm::toString(input.takeError()) << "\n";
+			exit(1);
+		}
+
+		// Every jolt module is part of this link, so of the program's own symbols only main has to stay visible to the C
+		// runtime. Symbols the optimizer added, such as the counters and version -fprofile-generate hands to
+		// compiler-rt, and anything kept by llvm.used stay visible to the objects they are linked with
+		std::vector<llvm::lto::SymbolResolution> resolutions;
+
+		for (auto &symbol : (*input)->symbols())
+		{
+			llvm::lto::SymbolResolution resolution;
+			resolution.Prevailing = !symbol.isUndefined();
+			resolution.FinalDefinitionInLinkageUnit = !symbol.isUndefined();
+			resolution.VisibleToRegularObj = symbol.getName() == "main" || symbol.isUsed() || !joltSymbols.count(symbol.getName().str());
+			resolutions.push_back(resolution);
+		}
+
+		if (auto err = lto.add(std::move(*input), resolutions))
+		{
+			llvm::errs() << "Error: " << llvm::toString(std::move(err)) << "\n";
+			exit(1);
+		}
+	}
+
+	std::vector<std::string> objects(lto.getMaxTasks());
+
+	auto objectPath = [&](unsigned task) -> std::string &
+	{
+		objects[task] = temporaryObject();
+		return objects[task];
+	};
+
+	auto addStream = [&](unsigned task, const llvm::Twine &) -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>>
+	{
+		std::error_code ec;
+		auto os = std::make_unique<llvm::raw_fd_ostream>(objectPath(task), ec);
+
+		if (ec)
+			return llvm::errorCodeToError(ec);
+
+		return std::make_unique<llvm::CachedFileStream>(std::move(os), objects[task]);
+	};
+
+	auto addBuffer = [&](unsigned task, const llvm::Twine &, std::unique_ptr<llvm::MemoryBuffer> buffer)
+	{
+		std::error_code ec;
+		llvm::raw_fd_ostream os(objectPath(task), ec);
+		os << buffer->getBuffer();
+	};
+
+	// Backend results are cached by module hash, so unchanged modules are not compiled again
+	auto cache = llvm::localCache("ThinLTO", "thinlto", ".jolt-cache", addBuffer);
+
+	if (!cache)
+	{
+		llvm::errs() << "Error: " << llvm::toString(cache.takeError()) << "\n";
+		exit(1);
+	}
+
+	if (auto err = lto.run(addStream, *cache))
+	{
+		llvm::errs() << "Error: " << llvm::toString(std::move(err)) << "\n";
+		exit(1);
+	}
+
+	objects.erase(std::remove(objects.begin(), objects.end(), ""), objects.end());
+	return objects;
+}
+
+llvm::Value *FunctionDefinition::codegen(GScope *scope, Generator *gen)
+{
+	// A generic function has no code of its own, its instances are generated once calls need them
+	if (!body || !typeParams.empty())
+		return nullptr;
+
+	return define(gen->functionSymbols[moduleName][name], scope, gen);
+}
+
+// Whether a parameter slot holds nothing but the incoming argument, it is only ever loaded from
+static bool holdsArgument(llvm::Value *ptr)
+{
+	for (auto user : ptr->users())
+	{
+		if (llvm::isa<llvm::LoadInst>(user))
+			continue;
+
+		if (auto store = llvm::dyn_cast<llvm::StoreInst>(user); store && store->getPointerOperand() == ptr && llvm::isa<llvm::Argument>(store->getValueOperand()))
+			continue;
+
+		if (auto gep = llvm::dyn_cast<llvm::GetElementPtrInst>(user); gep && gep->getPointerOperand() == ptr && holdsArgument(gep))
+			continue;
+
+		return false;
+	}
+
+	return true;
+}
+
+llvm::Value *FunctionDefinition::define(llvm::Function *func, GScope *scope, Generator *gen)
+{
+	GScope *funcScope = new GScope(scope);
+
+	llvm::BasicBlock *entry = llvm::BasicBlock::Create(gen->ctx, "entry", func);
+	gen->builder.SetInsertPoint(entry);
+
+	const FunctionABI &abi = gen->functionABIs[func];
+
+	for (size_t i = 0; i < abi.params.size(); ++i)
+	{
+		const ABIArgInfo &info = abi.params[i];
+		GType ty = gen->typeInfo(paramTypes[i]);
+		llvm::Value *storage;
+
+		if (info.kind == ABIArgInfo::Indirect)
+		{
+			// A byval argument already is a private copy, so it is used in place
+			storage = func->getArg(info.firstArg);
+		}
+		else if (info.kind == ABIArgInfo::Coerce)
+		{
+			std::vector<llvm::Value *> pieces;
+
+			for (size_t piece = 0; piece < info.pieces.size(); ++piece)
+				pieces.push_back(func->getArg(info.firstArg + piece));
+
+			storage = gen->createOverlayAlloca(info.type, info.coercedType(gen->ctx));
+			gen->storePieces(storage, info, pieces);
+		}
+		else
+		{
+			storage = gen->builder.CreateAlloca(info.type);
+			gen->builder.CreateStore(func->getArg(info.firstArg), storage);
+		}
+
+		storage->setName(paramNames[i]);
+		funcScope->variables[paramNames[i]] = std::pair{storage, ty};
+		gen->parameterSlots[storage] = paramNames[i];
+	}
+
+	body->codegen(funcScope, gen);
+
+	// A parameter passed on by an @tail call must not have been reassigned or had its address taken anywhere in the body
+	for (auto &[callee, slot] : gen->forwardedParameters)
+	{
+		if (!holdsArgument(slot))
+		{
+			std::cerr << "@tail call to " << callee << " cannot be guaranteed: parameter " << gen->parameterSlots[slot] << " of " << name
+					  << " is reassigned or has its address taken, so it may point into the stack frame\n";
+			exit(1);
+		}
+	}
+
+	gen->parameterSlots.clear();
+	gen->forwardedParameters.clear();
+
+	if (!gen->builder.GetInsertBlock()->getTerminator())
+	{
+		if (func->getReturnType()->isVoidTy())
+			gen->builder.CreateRetVoid();
+		else
+			gen->builder.CreateRet(llvm::Constant::getNullValue(func->getReturnType()));
+	}
+
+	return func;
+}
+
+llvm::Value *Block::codegen(GScope *scope, Generator *gen)
+{
+	GScope *blockScope = new GScope(scope);
+
+	for (auto &node : body)
+	{
+		// Statements after a return can never run
+		if (gen->builder.GetInsertBlock()->getTerminator())
+			break;
+
+		node->codegen(blockScope, gen);
+	}
+
+	gen->endLifetimes(blockScope);
+
+	return nullptr;
+}
+
+llvm::Value *StringLiteral::codegen(GScope *scope, Generator *gen)
+{
+	return gen->builder.CreateGlobalStringPtr(value);
+}
+
+llvm::Value *CharLiteral::codegen(GScope *scope, Generator *gen)
+{
+	return gen->builder.getInt8(value);
+}
+
+llvm::Value *IntLiteral::codegen(GScope *scope, Generator *gen)
+{
+	return gen->builder.getInt32(value);
+}
+
+llvm::Value *BoolLiteral::codegen(GScope *scope, Generator *gen)
+{
+	return gen->builder.getInt1(value);
+}
+
+llvm::Value *Variable::codegen(GScope *scope, Generator *gen)
+{
+	auto var = scope->getVar(name);
+
+	if (!var.first)
+	{
+		std::cerr << "Could not find variable with name: " << name << "\n";
+		return nullptr;
+	}
+
+	if (scope->inRegister(name))
+		return gen->inReferenceContext ? gen->spill(name, scope) : var.first;
+
+	if (gen->inReferenceContext)
+		return var.first;
+
+	// Scalar constants are used by value, which also lets them fold into the initializers of other constants
+	auto global = llvm::dyn_cast<llvm::GlobalVariable>(var.first);
+
+	if (global && global->isConstant() && global->hasInitializer() && !var.second.type(gen->ctx)->isAggregateType())
+		return global->getInitializer();
+
+	return gen->builder.CreateLoad(var.second.type(gen->ctx), var.first);
+}
+
+llvm::Value *BinaryExpr::codegen(GScope *scope, Generator *gen)
+{
+	llvm::Value *lhsValue = lhs->codegen(scope, gen);
+	llvm::Value *rhsValue = rhs->codegen(scope, gen);
+
+	if (!lhsValue || !rhsValue)
+		return nullptr;
+
+	auto lhsType = gen->expressionType(lhs, scope);
+	auto rhsType = gen->expressionType(rhs, scope);
+
+	if (op.type == TOKEN_OPERATOR_PLUS && lhsType.isPointer() && rhsType.type(gen->ctx)->isIntegerTy())
+		return gen->builder.CreateGEP(lhsType.elementType, lhsValue, gen->convert(rhsValue, gen->builder.getInt64Ty(), rhsType.isSigned), "ptr_add");
+
+	if (op.type == TOKEN_OPERATOR_PLUS && rhsType.isPointer() && lhsType.type(gen->ctx)->isIntegerTy())
+		return gen->builder.CreateGEP(rhsType.elementType, rhsValue, gen->convert(lhsValue, gen->builder.getInt64Ty(), lhsType.isSigned), "ptr_add");
+
+	// Each operand is extended by its own signedness before both meet at the common type,
+	// scalar operands of a lane-wise operation are broadcast to every lane
+	GType type = gen->operandType(this, scope);
+
+	if (!type.isPointer())
+	{
+		lhsValue = gen->coerce(lhsValue, type.type(gen->ctx), lhsType.isSigned);
+		rhsValue = gen->coerce(rhsValue, type.type(gen->ctx), rhsType.isSigned);
+	}
+
+	bool isFloat = lhsValue->getType()->isFPOrFPVectorTy();
+	bool isSigned = type.isSigned && !type.isPointer();
+
+	// Overflow is undefined unless -fwrapv is given, which lets loops be widened and strength reduced
+	bool noSignedWrap = isSigned && !gen->options.wrapv;
+	bool noUnsignedWrap = !isSigned && !gen->options.wrapv;
+
+	bool isBitwise = op.type == TOKEN_OPERATOR_BIT_AND || op.type == TOKEN_OPERATOR_BIT_OR || op.type == TOKEN_OPERATOR_BIT_XOR ||
+					 op.type == TOKEN_OPERATOR_SHL || op.type == TOKEN_OPERATOR_SHR;
+
+	if (isBitwise && !lhsValue->getType()->isIntOrIntVectorTy())
+	{
+		std::cerr << "operator " << op.value << " expects integer operands\n";
+		exit(1);
+	}
+
+	switch (op.type)
+	{
+	case TOKEN_OPERATOR_PLUS:
+		if (isFloat)
+			return gen->builder.CreateFAdd(lhsValue, rhsValue);
+		return gen->builder.CreateAdd(lhsValue, rhsValue, "", noUnsignedWrap, noSignedWrap);
+	case TOKEN_OPERATOR_MINUS:
+		if (isFloat)
+			return gen->builder.CreateFSub(lhsValue, rhsValue);
+		return gen->builder.CreateSub(lhsValue, rhsValue, "", noUnsignedWrap, noSignedWrap);
+	case TOKEN_OPERATOR_MUL:
+		if (isFloat)
+			return gen->builder.CreateFMul(lhsValue, rhsValue);
+		return gen->builder.CreateMul(lhsValue, rhsValue, "", noUnsignedWrap, noSignedWrap);
+	case TOKEN_OPERATOR_DIV:
+		if (isFloat)
+			return gen->builder.CreateFDiv(lhsValue, rhsValue);
+		return isSigned ? gen->builder.CreateSDiv(lhsValue, rhsValue) : gen->builder.CreateUDiv(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_MOD:
+		if (isFloat)
+			return gen->builder.CreateFRem(lhsValue, rhsValue);
+		return isSigned ? gen->builder.CreateSRem(lhsValue, rhsValue) : gen->builder.CreateURem(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_EQUAL:
+		if (isFloat)
+			return gen->builder.CreateFCmpOEQ(lhsValue, rhsValue);
+		return gen->builder.CreateICmpEQ(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_NOT_EQUAL:
+		if (isFloat)
+			return gen->builder.CreateFCmpUNE(lhsValue, rhsValue);
+		return gen->builder.CreateICmpNE(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_LESS:
+		if (isFloat)
+			return gen->builder.CreateFCmpOLT(lhsValue, rhsValue);
+		return isSigned ? gen->builder.CreateICmpSLT(lhsValue, rhsValue) : gen->builder.CreateICmpULT(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_GREATER:
+		if (isFloat)
+			return gen->builder.CreateFCmpOGT(lhsValue, rhsValue);
+		return isSigned ? gen->builder.CreateICmpSGT(lhsValue, rhsValue) : gen->builder.CreateICmpUGT(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_LESS_EQUAL:
+		if (isFloat)
+			return gen->builder.CreateFCmpOLE(lhsValue, rhsValue);
+		return isSigned ? gen->builder.CreateICmpSLE(lhsValue, rhsValue) : gen->builder.CreateICmpULE(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_GREATER_EQUAL:
+		if (isFloat)
+			return gen->builder.CreateFCmpOGE(lhsValue, rhsValue);
+		return isSigned ? gen->builder.CreateICmpSGE(lhsValue, rhsValue) : gen->builder.CreateICmpUGE(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_AND:
+	case TOKEN_OPERATOR_BIT_AND:
+		return gen->builder.CreateAnd(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_OR:
+	case TOKEN_OPERATOR_BIT_OR:
+		return gen->builder.CreateOr(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_BIT_XOR:
+		return gen->builder.CreateXor(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_SHL:
+		return gen->builder.CreateShl(lhsValue, rhsValue);
+	case TOKEN_OPERATOR_SHR:
+		return isSigned ? gen->builder.CreateAShr(lhsValue, rhsValue) : gen->builder.CreateLShr(lhsValue, rhsValue);
+	default:
+		return nullptr;
+	}
+}
+
+// The type both operands of a binary expression are brought to: a shift takes the type of its left operand, a float beats an integer, the wider integer wins
+// and at equal widths the unsigned one does, so u32 against an i32 literal stays an unsigned operation
+GType Generator::operandType(BinaryExpr *binary, GScope *scope)
+{
+	GType lhsType = expressionType(binary->lhs, scope);
+	GType rhsType = expressionType(binary->rhs, scope);
+
+	// A shift keeps the type of the value being shifted, whatever type the amount has
+	if ((binary->op.type == TOKEN_OPERATOR_SHL || binary->op.type == TOKEN_OPERATOR_SHR) && !lhsType.isPointer() &&
+		(lhsType.elementType->isVectorTy() || !rhsType.elementType->isVectorTy()))
+		return lhsType;
+
+	if (lhsType.isPointer() || rhsType.isPointer())
+		return lhsType.isPointer() ? lhsType : rhsType;
+
+	if (lhsType.elementType->isVectorTy() != rhsType.elementType->isVectorTy())
+		return lhsType.elementType->isVectorTy() ? lhsType : rhsType;
+
+	if (lhsType.elementType->isFPOrFPVectorTy() != rhsType.elementType->isFPOrFPVectorTy())
+		return lhsType.elementType->isFPOrFPVectorTy() ? lhsType : rhsType;
+
+	if (!lhsType.elementType->isIntegerTy() || !rhsType.elementType->isIntegerTy())
+		return lhsType;
+
+	unsigned lhsBits = lhsType.elementType->getIntegerBitWidth();
+	unsigned rhsBits = rhsType.elementType->getIntegerBitWidth();
+
+	if (lhsBits != rhsBits)
+		return lhsBits > rhsBits ? lhsType : rhsType;
+
+	return lhsType.isSigned ? rhsType : lhsType;
+}
+
+// An immutable variable, or an element or field of one, whose address is only ever read through
+static bool isImmutableBinding(ASTNode *expr, GScope *scope)
+{
+	if (auto var = dynamic_cast<Variable *>(expr))
+		return scope->isImmutable(var->name);
+
+	auto access = dynamic_cast<VariableAccess *>(expr);
+	return access && scope->isImmutable(access->varName) && !scope->getVar(access->varName).second.isPointer();
+}
+
+GType Generator::expressionType(ASTNode *expr, GScope *scope)
+{
+	if (auto *intLit = dynamic_cast<IntLiteral *>(expr))
+	{
+		return GType{llvm::Type::getInt32Ty(ctx), 0};
+	}
+
+	if (auto *stringLit = dynamic_cast<StringLiteral *>(expr))
+	{
+		return GType{llvm::Type::getInt8Ty(ctx), 1};
+	}
+
+	if (auto *charLit = dynamic_cast<CharLiteral *>(expr))
+	{
+		return GType{llvm::Type::getInt8Ty(ctx), 0};
+	}
+
+	if (auto *boolLit = dynamic_cast<BoolLiteral *>(expr))
+	{
+		return GType{llvm::Type::getInt1Ty(ctx), 0};
+	}
+
+	if (auto *tuple = dynamic_cast<TupleLiteral *>(expr))
+	{
+		std::vector<GType> elements;
+
+		for (auto value : tuple->values)
+			elements.push_back(expressionType(value, scope));
+
+		return GType{tupleType(elements), 0};
+	}
+
+	if (auto *var = dynamic_cast<Variable *>(expr))
+	{
+		return scope->getVar(var->name).second;
+	}
+
+	if (auto *literal = dynamic_cast<StructLiteral *>(expr))
+	{
+		return GType{literalInfo(literal, scope).type, 0};
+	}
+
+	if (auto *unary = dynamic_cast<UnaryExpr *>(expr))
+	{
+		GType subType = expressionType(unary->expr, scope);
+		// Memory behind a ^const pointer stays read only, and so does a pointer to it
+		if (unary->op.type == TOKEN_POINTER)
+		{
+			GType pointee{subType.elementType, subType.depth - 1, subType.isSigned};
+			pointee.isReadOnly = subType.isReadOnly && !pointee.isPointer();
+			return pointee;
+		}
+		// The address of an immutable binding is ^const, so its value and recorded range cannot change behind its back
+		if (unary->op.type == TOKEN_REFERENCE)
+		{
+			GType reference{subType.elementType, subType.depth + 1, subType.isSigned};
+			reference.isReadOnly = subType.isReadOnly || isImmutableBinding(unary->expr, scope);
+			return reference;
+		}
+		return subType;
+	}
+
+	if (auto *binary = dynamic_cast<BinaryExpr *>(expr))
+	{
+		GType type = operandType(binary, scope);
+
+		switch (binary->op.type)
+		{
+		case TOKEN_OPERATOR_EQUAL:
+		case TOKEN_OPERATOR_NOT_EQUAL:
+		case TOKEN_OPERATOR_LESS:
+		case TOKEN_OPERATOR_GREATER:
+		case TOKEN_OPERATOR_LESS_EQUAL:
+		case TOKEN_OPERATOR_GREATER_EQUAL:
+			if (auto vectorType = llvm::dyn_cast<llvm::VectorType>(type.elementType); vectorType && !type.isPointer())
+				return GType{llvm::VectorType::get(llvm::Type::getInt1Ty(ctx), vectorType->getElementCount()), 0};
+
+			return GType{llvm::Type::getInt1Ty(ctx), 0};
+		default:
+			return type;
+		}
+	}
+
+	if (auto *access = dynamic_cast<VariableAccess *>(expr))
+	{
+		if (auto info = enumInfo(access, scope))
+			return info->type;
+
+		GType type = scope->getVar(access->varName).second;
+
+		for (auto &index : access->indexes)
+		{
+			auto element = type.isPointer() ? nullptr : sliceElement(type.elementType);
+			bool readOnly = type.isReadOnly;
+
+			if (dynamic_cast<SliceRange *>(index))
+			{
+				type = GType{sliceType(element ? element : type.elementType->getArrayElementType()), 0, type.isSigned};
+			}
+			else if (dynamic_cast<ArrayIndex *>(index) && type.isPointer())
+			{
+				type = GType{type.elementType, type.depth - 1, type.isSigned};
+			}
+			else if (dynamic_cast<ArrayIndex *>(index) && element)
+			{
+				type = GType{element, 0, type.isSigned};
+			}
+			else if (dynamic_cast<ArrayIndex *>(index) && type.elementType->isArrayTy())
+			{
+				type = GType{type.elementType->getArrayElementType(), 0, type.isSigned};
+			}
+			else if (auto field = dynamic_cast<StructField *>(index); field && element)
+			{
+				type = field->fieldName == "len" ? GType{llvm::Type::getInt64Ty(ctx), 0} : GType{element, 1, type.isSigned};
+			}
+			else if (auto field = dynamic_cast<StructField *>(index))
+			{
+				auto structType = llvm::cast<llvm::StructType>(type.elementType);
+				StructInfo &info = structInfo(structType);
+				unsigned int fieldIndex = info.getFieldIndex(field->fieldName);
+				type = GType{structType->getElementType(fieldIndex), 0, info.fieldSigned[fieldIndex]};
+			}
+
+			// Elements, fields and sub-slices reached through a ^const pointer are read only, and so is the .ptr of
+			// such a slice, but a pointer merely stored there is not
+			bool slicePointer = element && dynamic_cast<StructField *>(index);
+			type.isReadOnly = readOnly && (!type.isPointer() || slicePointer);
+		}
+
+		return type;
+	}
+
+	if (auto *cast = dynamic_cast<Cast *>(expr))
+	{
+		return typeInfo(cast->type);
+	}
+
+	if (auto *call = dynamic_cast<FunctionCall *>(expr))
+	{
+		if (auto function = callee(call, scope))
+			return returnTypes[function];
+	}
+
+	if (auto *builtin = dynamic_cast<Builtin *>(expr))
+	{
+		if (builtin->type)
+			return typeInfo(builtin->type);
+
+		if (builtin->args.empty())
+			return GType{llvm::Type::getVoidTy(ctx), 0};
+
+		if (builtin->name == "prefetch" || builtin->name == "stream_store" || builtin->name == "memcpy" || builtin->name == "memmove" || builtin->name == "memset")
+			return GType{llvm::Type::getVoidTy(ctx), 0};
+
+		if (builtin->name == "memcmp")
+			return GType{llvm::Type::getInt32Ty(ctx), 0};
+
+		if (builtin->name == "len")
+			return GType{llvm::Type::getInt64Ty(ctx), 0};
+
+		GType argType = expressionType(builtin->args[0], scope);
+
+		if (builtin->name == "extract" || builtin->name.rfind("reduce_", 0) == 0)
+		{
+			if (auto vectorType = llvm::dyn_cast<llvm::VectorType>(argType.elementType))
+				return GType{vectorType->getElementType(), 0, argType.isSigned};
+		}
+		else if (builtin->name == "shuffle")
+		{
+			auto mask = dynamic_cast<ArrayLiteral *>(builtin->args.back());
+			auto vectorType = llvm::dyn_cast<llvm::VectorType>(argType.elementType);
+
+			if (mask && vectorType)
+				return GType{llvm::FixedVectorType::get(vectorType->getElementType(), mask->values.size()), 0, argType.isSigned};
+		}
+		else if (builtin->name == "select" && builtin->args.size() > 1)
+		{
+			return expressionType(builtin->args[1], scope);
+		}
+
+		return argType;
+	}
+
+	return GType{llvm::Type::getInt32Ty(ctx), 0};
+}
+
+llvm::Value *Generator::convert(llvm::Value *value, llvm::Type *target, bool isSigned)
+{
+	auto source = value->getType();
+
+	if (source == target || source->isVectorTy() != target->isVectorTy())
+		return value;
+
+	// Vectors convert lane-wise, so only the lane types matter
+	auto sourceLane = source->getScalarType();
+	auto targetLane = target->getScalarType();
+
+	if (sourceLane->isIntegerTy() && targetLane->isIntegerTy())
+		return builder.CreateIntCast(value, target, isSigned && !sourceLane->isIntegerTy(1));
+
+	if (sourceLane->isIntegerTy() && targetLane->isFloatingPointTy())
+		return isSigned ? builder.CreateSIToFP(value, target) : builder.CreateUIToFP(value, target);
+
+	if (sourceLane->isFloatingPointTy() && targetLane->isIntegerTy())
+		return isSigned ? builder.CreateFPToSI(value, target) : builder.CreateFPToUI(value, target);
+
+	if (sourceLane->isFloatingPointTy() && targetLane->isFloatingPointTy())
+		return builder.CreateFPCast(value, target);
+
+	return value;
+}
+
+llvm::Value *Generator::coerce(llvm::Value *value, llvm::Type *target, bool isSigned)
+{
+	auto source = value->getType();
+
+	if (source == target)
+		return value;
+
+	if (auto vectorType = llvm::dyn_cast<llvm::FixedVectorType>(target))
+	{
+		auto laneType = vectorType->getElementType();
+
+		if (auto arrayType = llvm::dyn_cast<llvm::ArrayType>(source))
+		{
+			if (arrayType->getNumElements() != vectorType->getNumElements())
+			{
+				std::cerr << "array literal has " << arrayType->getNumElements() << " elements but the vector has " << vectorType->getNumElements() << " lanes\n";
+				exit(1);
+			}
+
+			llvm::Value *vector = llvm::PoisonValue::get(vectorType);
+
+			for (unsigned i = 0; i < vectorType->getNumElements(); ++i)
+			{
+				auto lane = convert(builder.CreateExtractValue(value, i), laneType, isSigned);
+				vector = builder.CreateInsertElement(vector, lane, builder.getInt32(i));
+			}
+
+			return vector;
+		}
+
+		if (!source->isVectorTy())
+			return builder.CreateVectorSplat(vectorType->getNumElements(), convert(value, laneType, isSigned));
+
+		return value;
+	}
+
+	return convert(value, target, isSigned);
+}
+
+llvm::Value *Cast::codegen(GScope *scope, Generator *gen)
+{
+	auto val = expr->codegen(scope, gen);
+
+	GType targetGType = gen->typeInfo(type);
+	GType sourceGType = gen->expressionType(expr, scope);
+
+	auto targetType = targetGType.type(gen->ctx);
+	auto sourceType = sourceGType.type(gen->ctx);
+
+	if (sourceType->isIntegerTy() && targetType->isIntegerTy())
+	{
+		unsigned srcBits = sourceType->getIntegerBitWidth();
+		unsigned dstBits = targetType->getIntegerBitWidth();
+
+		if (srcBits == dstBits)
+		{
+			return val;
+		}
+		else if (srcBits < dstBits)
+		{
+			// Widening extends by the signedness of the source, so @cast(i64, x) of a u32 never goes negative
+			if (sourceGType.isSigned && srcBits > 1)
+			{
+				return gen->builder.CreateSExt(val, targetType, "sext");
+			}
+			else
+			{
+				return gen->builder.CreateZExt(val, targetType, "zext");
+			}
+		}
+		else
+		{
+			return gen->builder.CreateTrunc(val, targetType, "trunc");
+		}
+	}
+
+	// An integer source converts by its own signedness, a float source by the signedness of the integer it becomes
+	if (sourceType->isFPOrFPVectorTy() || targetType->isFPOrFPVectorTy() || sourceType->isVectorTy())
+		return gen->convert(val, targetType, sourceType->isIntOrIntVectorTy() ? sourceGType.isSigned : targetGType.isSigned);
+
+	return nullptr;
+}
+
+static void expectArgCount(Builtin *builtin, size_t count)
+{
+	if (builtin->args.size() != count)
+	{
+		std::cerr << "@" << builtin->name << " expects " << count << " arguments, received " << builtin->args.size() << "\n";
+		exit(1);
+	}
+}
+
+static llvm::FixedVectorType *expectVector(Builtin *builtin, llvm::Value *value)
+{
+	auto vectorType = llvm::dyn_cast<llvm::FixedVectorType>(value->getType());
+
+	if (!vectorType)
+	{
+		std::cerr << "@" << builtin->name << " expects a vector operand\n";
+		exit(1);
+	}
+
+	return vectorType;
+}
+
+llvm::Value *Builtin::codegen(GScope *scope, Generator *gen)
+{
+	if (name == "splat")
+	{
+		expectArgCount(this, 1);
+		auto vectorType = gen->typeInfo(type).type(gen->ctx);
+
+		if (!vectorType->isVectorTy())
+		{
+			std::cerr << "@splat expects a vector type\n";
+			exit(1);
+		}
+
+		return gen->coerce(args[0]->codegen(scope, gen), vectorType);
+	}
+
+	if (name == "shuffle")
+	{
+		if (args.size() != 2 && args.size() != 3)
+		{
+			std::cerr << "@shuffle expects (a, mask) or (a, b, mask)\n";
+			exit(1);
+		}
+
+		auto maskLiteral = dynamic_cast<ArrayLiteral *>(args.back());
+		std::vector<int> mask;
+
+		for (auto lane : maskLiteral ? maskLiteral->values : std::vector<ASTNode *>{})
+		{
+			auto laneIndex = dynamic_cast<IntLiteral *>(lane);
+
+			if (!laneIndex)
+			{
+				maskLiteral = nullptr;
+				break;
+			}
+
+			mask.push_back(laneIndex->value);
+		}
+
+		if (!maskLiteral)
+		{
+			std::cerr << "@shuffle mask must be an array literal of constant lane indices\n";
+			exit(1);
+		}
+
+		auto a = args[0]->codegen(scope, gen);
+		auto vectorType = expectVector(this, a);
+		auto b = args.size() == 3 ? args[1]->codegen(scope, gen) : llvm::PoisonValue::get(vectorType);
+
+		for (int lane : mask)
+		{
+			if (lane < 0 || lane >= (int)(vectorType->getNumElements() * 2))
+			{
+				std::cerr << "@shuffle lane index out of range: " << lane << "\n";
+				exit(1);
+			}
+		}
+
+		return gen->builder.CreateShuffleVector(a, b, mask);
+	}
+
+	if (name == "extract")
+	{
+		expectArgCount(this, 2);
+		auto vector = args[0]->codegen(scope, gen);
+		expectVector(this, vector);
+
+		return gen->builder.CreateExtractElement(vector, args[1]->codegen(scope, gen));
+	}
+
+	if (name == "insert")
+	{
+		expectArgCount(this, 3);
+		auto vector = args[0]->codegen(scope, gen);
+		auto vectorType = expectVector(this, vector);
+		auto laneIndex = args[1]->codegen(scope, gen);
+		auto lane = gen->convert(args[2]->codegen(scope, gen), vectorType->getElementType());
+
+		return gen->builder.CreateInsertElement(vector, lane, laneIndex);
+	}
+
+	if (name == "select")
+	{
+		expectArgCount(this, 3);
+		auto mask = args[0]->codegen(scope, gen);
+		auto a = args[1]->codegen(scope, gen);
+		auto b = gen->coerce(args[2]->codegen(scope, gen), a->getType());
+
+		return gen->builder.CreateSelect(mask, a, b);
+	}
+
+	if (name == "likely" || name == "unlikely")
+	{
+		expectArgCount(this, 1);
+		auto cond = args[0]->codegen(scope, gen);
+
+		return gen->builder.CreateIntrinsic(llvm::Intrinsic::expect, {cond->getType()}, {cond, llvm::ConstantInt::get(cond->getType(), name == "likely")});
+	}
+
+	if (name == "assume")
+	{
+		expectArgCount(this, 1);
+		return gen->builder.CreateAssumption(args[0]->codegen(scope, gen));
+	}
+
+	if (name == "unreachable")
+	{
+		expectArgCount(this, 0);
+		auto func = gen->builder.GetInsertBlock()->getParent();
+		gen->builder.CreateUnreachable();
+
+		// Anything that follows is dead but still needs a block to be emitted into
+		gen->builder.SetInsertPoint(llvm::BasicBlock::Create(gen->ctx, "unreachable.cont", func));
+		return nullptr;
+	}
+
+	if (name == "prefetch")
+	{
+		if (args.empty() || args.size() > 3)
+		{
+			std::cerr << "@prefetch expects (ptr), (ptr, rw) or (ptr, rw, locality)\n";
+			exit(1);
+		}
+
+		// rw: 0 read, 1 write. locality: 0 no temporal locality up to 3 keep in all cache levels
+		int operands[] = {0, 3};
+
+		for (size_t i = 1; i < args.size(); ++i)
+		{
+			auto constant = dynamic_cast<IntLiteral *>(args[i]);
+
+			if (!constant || constant->value < 0 || constant->value > (i == 1 ? 1 : 3))
+			{
+				std::cerr << "@prefetch rw must be the constant 0 or 1 and locality a constant from 0 to 3\n";
+				exit(1);
+			}
+
+			operands[i - 1] = constant->value;
+		}
+
+		auto ptr = args[0]->codegen(scope, gen);
+
+		return gen->builder.CreateIntrinsic(llvm::Intrinsic::prefetch, {ptr->getType()}, {ptr, gen->builder.getInt32(operands[0]), gen->builder.getInt32(operands[1]), gen->builder.getInt32(1)});
+	}
+
+	if (name == "stream_store")
+	{
+		expectArgCount(this, 2);
+		auto ptrType = gen->expressionType(args[0], scope);
+
+		if (!ptrType.isPointer())
+		{
+			std::cerr << "@stream_store expects a pointer as its first argument\n";
+			exit(1);
+		}
+
+		if (ptrType.isReadOnly)
+		{
+			std::cerr << "@stream_store cannot write through a ^const pointer\n";
+			exit(1);
+		}
+
+		auto ptr = args[0]->codegen(scope, gen);
+		auto value = gen->coerce(args[1]->codegen(scope, gen), GType{ptrType.elementType, ptrType.depth - 1}.type(gen->ctx));
+		auto store = gen->builder.CreateStore(value, ptr);
+
+		// Non-temporal: bypass the caches for data that will not be read back soon
+		store->setMetadata(llvm::LLVMContext::MD_nontemporal, llvm::MDNode::get(gen->ctx, llvm::ConstantAsMetadata::get(gen->builder.getInt32(1))));
+
+		return store;
+	}
+
+	if (name == "len")
+	{
+		expectArgCount(this, 1);
+		GType type = gen->expressionType(args[0], scope);
+
+		if (type.elementType->isArrayTy() && !type.isPointer())
+			return gen->builder.getInt64(type.elementType->getArrayNumElements());
+
+		if (!gen->sliceElement(type.elementType) || type.isPointer())
+		{
+			std::cerr << "@len expects an array or a slice\n";
+			exit(1);
+		}
+
+		return gen->builder.CreateExtractValue(args[0]->codegen(scope, gen), 1);
+	}
+
+	if (name == "popcount" || name == "ctz" || name == "clz" || name == "bswap" || name == "abs")
+	{
+		expectArgCount(this, 1);
+		auto value = args[0]->codegen(scope, gen);
+		auto type = value->getType();
+
+		if (name == "abs" && type->isFPOrFPVectorTy())
+			return gen->builder.CreateUnaryIntrinsic(llvm::Intrinsic::fabs, value);
+
+		if (!type->isIntOrIntVectorTy() || (name == "bswap" && type->getScalarSizeInBits() % 16 != 0))
+		{
+			std::cerr << "@" << name << " expects an integer" << (name == "bswap" ? " of at least 16 bits" : "") << "\n";
+			exit(1);
+		}
+
+		if (name == "popcount")
+			return gen->builder.CreateUnaryIntrinsic(llvm::Intrinsic::ctpop, value);
+		if (name == "bswap")
+			return gen->builder.CreateUnaryIntrinsic(llvm::Intrinsic::bswap, value);
+
+		// ctz/clz of zero is the bit width and abs of the minimum value wraps, neither is poison
+		auto intrinsic = name == "ctz" ? llvm::Intrinsic::cttz : name == "clz" ? llvm::Intrinsic::ctlz : llvm::Intrinsic::abs;
+
+		return gen->builder.CreateIntrinsic(intrinsic, {type}, {value, gen->builder.getFalse()});
+	}
+
+	if (name == "rotl" || name == "rotr" || name == "min" || name == "max" || name == "add_sat" || name == "sub_sat")
+	{
+		expectArgCount(this, 2);
+		auto lhs = args[0]->codegen(scope, gen);
+		auto rhs = gen->coerce(args[1]->codegen(scope, gen), lhs->getType(), gen->expressionType(args[1], scope).isSigned);
+		bool isFloat = lhs->getType()->isFPOrFPVectorTy();
+		bool isSigned = gen->expressionType(args[0], scope).isSigned;
+
+		if (isFloat && (name == "min" || name == "max"))
+			return gen->builder.CreateBinaryIntrinsic(name == "min" ? llvm::Intrinsic::minnum : llvm::Intrinsic::maxnum, lhs, rhs);
+
+		if (!lhs->getType()->isIntOrIntVectorTy())
+		{
+			std::cerr << "@" << name << " expects integers\n";
+			exit(1);
+		}
+
+		// A rotate is a funnel shift of a value with itself
+		if (name == "rotl" || name == "rotr")
+			return gen->builder.CreateIntrinsic(name == "rotl" ? llvm::Intrinsic::fshl : llvm::Intrinsic::fshr, {lhs->getType()}, {lhs, lhs, rhs});
+
+		llvm::Intrinsic::ID intrinsic = name == "min"		? (isSigned ? llvm::Intrinsic::smin : llvm::Intrinsic::umin)
+										: name == "max"		? (isSigned ? llvm::Intrinsic::smax : llvm::Intrinsic::umax)
+										: name == "add_sat" ? (isSigned ? llvm::Intrinsic::sadd_sat : llvm::Intrinsic::uadd_sat)
+															: (isSigned ? llvm::Intrinsic::ssub_sat : llvm::Intrinsic::usub_sat);
+
+		return gen->builder.CreateBinaryIntrinsic(intrinsic, lhs, rhs);
+	}
+
+	if (name == "memcpy" || name == "memmove" || name == "memset" || name == "memcmp")
+	{
+		expectArgCount(this, 3);
+
+		if (name != "memcmp" && gen->expressionType(args[0], scope).isReadOnly)
+		{
+			std::cerr << "@" << name << " cannot write through a ^const pointer\n";
+			exit(1);
+		}
+		auto dst = args[0]->codegen(scope, gen);
+		auto src = args[1]->codegen(scope, gen);
+		auto size = gen->convert(args[2]->codegen(scope, gen), gen->builder.getInt64Ty(), false);
+
+		if (!dst->getType()->isPointerTy() || (name != "memset" && !src->getType()->isPointerTy()))
+		{
+			std::cerr << "@" << name << " expects pointer arguments\n";
+			exit(1);
+		}
+
+		if (name == "memcpy")
+			return gen->builder.CreateMemCpy(dst, llvm::MaybeAlign(), src, llvm::MaybeAlign(), size);
+		if (name == "memmove")
+			return gen->builder.CreateMemMove(dst, llvm::MaybeAlign(), src, llvm::MaybeAlign(), size);
+		if (name == "memset")
+			return gen->builder.CreateMemSet(dst, gen->convert(src, gen->builder.getInt8Ty()), size, llvm::MaybeAlign());
+
+		// There is no memcmp intrinsic, but the optimizer recognizes the libc call and expands small sizes inline
+		auto memcmp = gen->module->getOrInsertFunction("memcmp", gen->builder.getInt32Ty(), dst->getType(), src->getType(), gen->builder.getInt64Ty());
+
+		return gen->builder.CreateCall(memcmp, {dst, src, size});
+	}
+
+	// Horizontal reductions
+	expectArgCount(this, 1);
+	auto vector = args[0]->codegen(scope, gen);
+	auto laneType = expectVector(this, vector)->getElementType();
+	bool isFloat = laneType->isFloatingPointTy();
+	bool isSigned = gen->expressionType(args[0], scope).isSigned;
+	llvm::Value *result = nullptr;
+
+	if (name == "reduce_add")
+		result = isFloat ? gen->builder.CreateFAddReduce(llvm::ConstantFP::getNegativeZero(laneType), vector) : gen->builder.CreateAddReduce(vector);
+	else if (name == "reduce_mul")
+		result = isFloat ? gen->builder.CreateFMulReduce(llvm::ConstantFP::get(laneType, 1.0), vector) : gen->builder.CreateMulReduce(vector);
+	else if (name == "reduce_min")
+		result = isFloat ? gen->builder.CreateFPMinReduce(vector) : gen->builder.CreateIntMinReduce(vector, isSigned);
+	else if (name == "reduce_max")
+		result = isFloat ? gen->builder.CreateFPMaxReduce(vector) : gen->builder.CreateIntMaxReduce(vector, isSigned);
+	else if (!isFloat && name == "reduce_and")
+		result = gen->builder.CreateAndReduce(vector);
+	else if (!isFloat && name == "reduce_or")
+		result = gen->builder.CreateOrReduce(vector);
+	else if (!isFloat && name == "reduce_xor")
+		result = gen->builder.CreateXorReduce(vector);
+	else
+	{
+		std::cerr << "@" << name << " is not supported on floating point vectors\n";
+		exit(1);
+	}
+
+	// Without reassociation a float reduction is evaluated strictly in lane order
+	if (isFloat)
+		llvm::cast<llvm::Instruction>(result)->setHasAllowReassoc(true);
+
+	return result;
+}
+
+llvm::Value *While::codegen(GScope *scope, Generator *gen)
+{
+	auto func = gen->builder.GetInsertBlock()->getParent();
+
+	GScope *whileScope = new GScope(scope);
+
+	auto condBlock = llvm::BasicBlock::Create(gen->ctx, "cond", func);
+	auto bodyBlock = llvm::BasicBlock::Create(gen->ctx, "body", func);
+	auto mergeBlock = llvm::BasicBlock::Create(gen->ctx, "merge", func);
+
+	gen->builder.CreateBr(condBlock);
+	gen->builder.SetInsertPoint(condBlock);
+
+	auto cond = condition->codegen(whileScope, gen);
+	gen->builder.CreateCondBr(cond, bodyBlock, mergeBlock, gen->branchWeights(condition));
+
+	gen->builder.SetInsertPoint(bodyBlock);
+
+	body->codegen(whileScope, gen);
+
+	if (!gen->builder.GetInsertBlock()->getTerminator())
+		gen->builder.CreateBr(condBlock);
+
+	gen->builder.SetInsertPoint(mergeBlock);
+
+	return nullptr;
+}
+
+static llvm::MDNode *loopMetadata(For *loop, Generator *gen, llvm::MDNode *accessGroup)
+{
+	std::vector<llvm::Metadata *> properties = {nullptr}; // operand 0 refers back to the loop id
+
+	auto property = [&](std::string name, llvm::Metadata *value)
+	{
+		properties.push_back(llvm::MDNode::get(gen->ctx, {llvm::MDString::get(gen->ctx, name), value}));
+	};
+	auto intValue = [&](unsigned bits, int value)
+	{
+		return llvm::ConstantAsMetadata::get(gen->builder.getIntN(bits, value));
+	};
+
+	for (auto &hint : loop->hints)
+	{
+		int count = hint.args.empty() ? 0 : std::stoi(hint.args[0]);
+
+		if (hint.name == "unroll")
+		{
+			if (hint.args.empty())
+				properties.push_back(llvm::MDNode::get(gen->ctx, llvm::MDString::get(gen->ctx, "llvm.loop.unroll.enable")));
+			else if (count <= 1)
+				properties.push_back(llvm::MDNode::get(gen->ctx, llvm::MDString::get(gen->ctx, "llvm.loop.unroll.disable")));
+			else
+				property("llvm.loop.unroll.count", intValue(32, count));
+		}
+		else if (hint.name == "vectorize")
+		{
+			property("llvm.loop.vectorize.enable", intValue(1, count != 1));
+
+			if (count > 1)
+				property("llvm.loop.vectorize.width", intValue(32, count));
+		}
+		else if (hint.name == "no_alias")
+		{
+			property("llvm.loop.parallel_accesses", accessGroup);
+		}
+	}
+
+	if (properties.size() == 1)
+		return nullptr;
+
+	auto loopID = llvm::MDNode::getDistinct(gen->ctx, properties);
+	loopID->replaceOperandWith(0, loopID);
+
+	return loopID;
+}
+
+llvm::Value *For::codegen(GScope *scope, Generator *gen)
+{
+	auto func = gen->builder.GetInsertBlock()->getParent();
+
+	GScope *forScope = new GScope(scope);
+
+	// Preheader: the bounds are evaluated exactly once, before the loop is entered
+	GType startGType = gen->expressionType(start, scope);
+	GType endGType = gen->expressionType(end, scope);
+	auto startType = startGType.type(gen->ctx);
+	auto endType = endGType.type(gen->ctx);
+	GType ivType = type ? gen->typeInfo(type) : endGType;
+
+	if (!type && startType->isIntegerTy() && endType->isIntegerTy() && startType->getIntegerBitWidth() > endType->getIntegerBitWidth())
+		ivType = startGType;
+
+	auto ivLLVMType = ivType.type(gen->ctx);
+
+	if (!ivLLVMType->isIntegerTy())
+	{
+		std::cerr << "for loop variable must be an integer: " << varName << "\n";
+		exit(1);
+	}
+
+	bool isSigned = ivType.isSigned;
+	auto startValue = gen->convert(start->codegen(scope, gen), ivLLVMType, startGType.isSigned);
+	auto endValue = gen->convert(end->codegen(scope, gen), ivLLVMType, endGType.isSigned);
+
+	auto iv = gen->createScopedAlloca(ivLLVMType, forScope, varName);
+	gen->builder.CreateStore(startValue, iv);
+	forScope->variables[varName] = std::pair{iv, ivType};
+	forScope->immutables.insert(varName);
+
+	auto constantStart = llvm::dyn_cast<llvm::ConstantInt>(startValue);
+	auto constantEnd = llvm::dyn_cast<llvm::ConstantInt>(endValue);
+
+	if (constantStart && constantEnd && isSigned)
+		forScope->ranges[varName] = {constantStart->getSExtValue(), constantEnd->getSExtValue() - 1};
+	else if (constantStart && constantEnd)
+		forScope->ranges[varName] = {(int64_t)constantStart->getZExtValue(), (int64_t)constantEnd->getZExtValue() - 1};
+
+	auto condBlock = llvm::BasicBlock::Create(gen->ctx, "for.cond", func);
+	auto bodyBlock = llvm::BasicBlock::Create(gen->ctx, "for.body", func);
+
+	gen->builder.CreateBr(condBlock);
+	gen->builder.SetInsertPoint(condBlock);
+
+	auto current = gen->builder.CreateLoad(ivLLVMType, iv, varName);
+	auto cond = isSigned ? gen->builder.CreateICmpSLT(current, endValue) : gen->builder.CreateICmpULT(current, endValue);
+
+	gen->builder.SetInsertPoint(bodyBlock);
+	body->codegen(forScope, gen);
+
+	// Single latch: every path through the body continues here
+	auto latchBlock = llvm::BasicBlock::Create(gen->ctx, "for.latch", func);
+	auto mergeBlock = llvm::BasicBlock::Create(gen->ctx, "for.end", func);
+
+	if (!gen->builder.GetInsertBlock()->getTerminator())
+		gen->builder.CreateBr(latchBlock);
+
+	gen->builder.SetInsertPoint(condBlock);
+	gen->builder.CreateCondBr(cond, bodyBlock, mergeBlock);
+
+	gen->builder.SetInsertPoint(latchBlock);
+	auto next = isSigned
+					? gen->builder.CreateNSWAdd(gen->builder.CreateLoad(ivLLVMType, iv), llvm::ConstantInt::get(ivLLVMType, 1), "next")
+					: gen->builder.CreateNUWAdd(gen->builder.CreateLoad(ivLLVMType, iv), llvm::ConstantInt::get(ivLLVMType, 1), "next");
+	gen->builder.CreateStore(next, iv);
+	auto backedge = gen->builder.CreateBr(condBlock);
+
+	auto accessGroup = llvm::MDNode::getDistinct(gen->ctx, {});
+	bool noAlias = std::any_of(hints.begin(), hints.end(), [](Directive &hint)
+							   { return hint.name == "no_alias"; });
+
+	if (auto loopID = loopMetadata(this, gen, accessGroup))
+		backedge->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+
+	// #no_alias: the body's memory accesses carry no loop-carried dependencies
+	for (auto block = condBlock->getIterator(); noAlias && block != mergeBlock->getIterator(); ++block)
+	{
+		for (auto &inst : *block)
+		{
+			if (inst.mayReadOrWriteMemory() && llvm::getLoadStorePointerOperand(&inst) != iv)
+				inst.setMetadata(llvm::LLVMContext::MD_access_group, accessGroup);
+		}
+	}
+
+	gen->builder.SetInsertPoint(mergeBlock);
+	gen->endLifetimes(forScope);
+
+	return nullptr;
+}
+
+llvm::Value *Conditional::codegen(GScope *scope, Generator *gen)
+{
+
+	auto func = gen->builder.GetInsertBlock()->getParent();
+	auto mergeBB = llvm::BasicBlock::Create(gen->ctx, "if.end", func);
+
+	for (auto &condition : conditions)
+	{
+		auto *condBB = llvm::BasicBlock::Create(gen->ctx, "if.cond", func);
+		auto *thenBB = llvm::BasicBlock::Create(gen->ctx, "if.then", func);
+		auto *elseBB = llvm::BasicBlock::Create(gen->ctx, "if.else", func);
+		gen->builder.CreateBr(condBB);
+		gen->builder.SetInsertPoint(condBB);
+
+		if (condition.first)
+		{
+			GScope *condScope = new GScope(scope);
+			auto *condValue = condition.first->codegen(condScope, gen);
+			if (!condValue)
+				return nullptr;
+
+			gen->builder.CreateCondBr(condValue, thenBB, elseBB, gen->branchWeights(condition.first));
+		}
+		else
+		{
+			gen->builder.CreateBr(thenBB);
+		}
+
+		gen->builder.SetInsertPoint(thenBB);
+
+		{
+			GScope *thenScope = new GScope(scope);
+			condition.second->codegen(thenScope, gen);
+
+			if (!gen->builder.GetInsertBlock()->getTerminator())
+				gen->builder.CreateBr(mergeBB);
+		}
+
+		gen->builder.SetInsertPoint(elseBB);
+	}
+
+	gen->builder.CreateBr(mergeBB);
+	gen->builder.SetInsertPoint(mergeBB);
+
+	return nullptr;
+}
+
+// Rejects assignment targets that may not be written, shared by assignments and asm outputs
+static void checkWritable(ASTNode *lhs, GScope *scope, Generator *gen)
+{
+	if (auto var = dynamic_cast<Variable *>(lhs))
+	{
+		if (isImmutableBinding(var, scope))
+		{
+			std::cerr << "cannot assign to immutable variable: " << var->name << "\n";
+			exit(1);
+		}
+	}
+
+	// Elements and fields of an immutable value are immutable too, only memory behind a pointer is not
+	if (auto access = dynamic_cast<VariableAccess *>(lhs))
+	{
+		if (isImmutableBinding(access, scope))
+		{
+			std::cerr << "cannot assign into immutable variable: " << access->varName << "\n";
+			exit(1);
+		}
+	}
+
+	// ^p = x and p[i].f = x store into what the last index steps into, which is read only behind a ^const pointer
+	auto deref = dynamic_cast<UnaryExpr *>(lhs);
+	auto access = dynamic_cast<VariableAccess *>(lhs);
+	bool readOnly = false;
+
+	if (deref && deref->op.type == TOKEN_POINTER)
+	{
+		readOnly = gen->expressionType(deref->expr, scope).isReadOnly;
+	}
+	else if (access && !access->indexes.empty())
+	{
+		VariableAccess container(access->varName, std::vector<ASTNode *>(access->indexes.begin(), access->indexes.end() - 1));
+		readOnly = gen->expressionType(&container, scope).isReadOnly;
+	}
+
+	if (readOnly)
+	{
+		auto base = deref ? dynamic_cast<Variable *>(deref->expr) : nullptr;
+		std::string baseName = base ? base->name : access ? access->varName : "";
+		std::cerr << "cannot write through ^const pointer" << (baseName.empty() ? "" : ": " + baseName) << "\n";
+		exit(1);
+	}
+}
+
+// A ^const pointer, or a slice of the memory behind one, cannot become a pointer or slice that may be written through
+void Generator::checkConstConversion(ASTNode *expr, GType target, GScope *scope, const std::string &context)
+{
+	// A struct literal is never a pointer, and may need the target to infer its type arguments
+	if (dynamic_cast<StructLiteral *>(expr))
+		return;
+
+	GType source = expressionType(expr, scope);
+
+	if (!source.isReadOnly || target.isReadOnly || !(source.isPointer() || sliceElement(source.elementType)))
+		return;
+
+	std::cerr << context << " drops the const of " << typeName(source) << ", declare the destination ^const\n";
+	exit(1);
+}
+
+llvm::Value *Assign::codegen(GScope *scope, Generator *gen)
+{
+	checkWritable(lhs, scope, gen);
+	gen->checkConstConversion(rhs, gen->expressionType(lhs, scope), scope, "assignment");
+
+	gen->inReferenceContext = true;
+	auto lvalue = lhs->codegen(scope, gen);
+	gen->inReferenceContext = false;
+
+	auto rvalue = gen->codegenAs(rhs, scope, gen->expressionType(lhs, scope).type(gen->ctx));
+
+	return gen->builder.CreateStore(rvalue, lvalue);
+}
+
+llvm::Value *Asm::codegen(GScope *scope, Generator *gen)
+{
+	std::vector<std::string> constraints;
+	std::vector<llvm::Value *> destinations;
+	std::vector<llvm::Type *> resultTypes;
+	std::vector<llvm::Value *> args;
+	std::vector<llvm::Type *> argTypes;
+	std::vector<std::pair<std::string, llvm::Value *>> tied; // current values of "+" outputs, passed again as inputs
+
+	for (auto &[constraint, lhs] : outputs)
+	{
+		if (constraint.empty() || (constraint[0] != '=' && constraint[0] != '+'))
+		{
+			std::cerr << "asm output constraint must start with = or +: " << constraint << "\n";
+			exit(1);
+		}
+
+		checkWritable(lhs, scope, gen);
+
+		gen->inReferenceContext = true;
+		auto lvalue = lhs->codegen(scope, gen);
+		gen->inReferenceContext = false;
+
+		auto type = gen->expressionType(lhs, scope).type(gen->ctx);
+
+		// LLVM has no read-write operands, "+r" is an "=r" output with an input tied to it
+		if (constraint[0] == '+')
+			tied.push_back({std::to_string(destinations.size()), gen->builder.CreateLoad(type, lvalue)});
+
+		constraints.push_back("=" + constraint.substr(1));
+		destinations.push_back(lvalue);
+		resultTypes.push_back(type);
+	}
+
+	for (auto &[constraint, expr] : inputs)
+	{
+		auto value = expr->codegen(scope, gen);
+		constraints.push_back(constraint);
+		args.push_back(value);
+		argTypes.push_back(value->getType());
+	}
+
+	for (auto &[constraint, value] : tied)
+	{
+		constraints.push_back(constraint);
+		args.push_back(value);
+		argTypes.push_back(value->getType());
+	}
+
+	// Operands in memory would need indirect constraints, pass a pointer in a register instead
+	for (auto &constraint : constraints)
+	{
+		if (constraint.substr(0, constraint.find('{')).find('m') != std::string::npos)
+		{
+			std::cerr << "asm memory operands are not supported: " << constraint << "\n";
+			exit(1);
+		}
+	}
+
+	// As C compilers do, x86 assembly is assumed to change the flags
+	bool isX86 = llvm::Triple(gen->module->getTargetTriple()).isX86();
+
+	for (auto &clobber : clobbers)
+	{
+		if (!(isX86 && clobber == "cc"))
+			constraints.push_back("~{" + clobber + "}");
+	}
+
+	if (isX86)
+		constraints.insert(constraints.end(), {"~{dirflag}", "~{fpsr}", "~{flags}"});
+
+	std::string constraintString = llvm::join(constraints, ",");
+
+	llvm::Type *resultType = llvm::Type::getVoidTy(gen->ctx);
+
+	if (resultTypes.size() == 1)
+		resultType = resultTypes[0];
+	else if (resultTypes.size() > 1)
+		resultType = llvm::StructType::get(gen->ctx, resultTypes);
+
+	auto asmType = llvm::FunctionType::get(resultType, argTypes, false);
+
+	if (auto error = llvm::InlineAsm::verify(asmType, constraintString))
+	{
+		std::cerr << "invalid asm constraints \"" << constraintString << "\": " << llvm::toString(std::move(error)) << "\n";
+		exit(1);
+	}
+
+	// Always volatile, the instructions are kept exactly where they are written
+	auto inlineAsm = llvm::InlineAsm::get(asmType, text, constraintString, true);
+	auto result = gen->builder.CreateCall(asmType, inlineAsm, args);
+
+	for (size_t i = 0; i < destinations.size(); ++i)
+	{
+		auto value = destinations.size() == 1 ? result : gen->builder.CreateExtractValue(result, i);
+		gen->builder.CreateStore(value, destinations[i]);
+	}
+
+	return nullptr;
+}
+
+static llvm::Value *subSlice(std::pair<llvm::Value *, GType> var, SliceRange *range, GScope *scope, Generator *gen)
+{
+	llvm::Type *elementType = gen->sliceElement(var.second.elementType);
+	llvm::Value *data, *length;
+
+	if (elementType && !var.second.isPointer())
+	{
+		auto slice = gen->builder.CreateLoad(var.second.elementType, var.first);
+		data = gen->builder.CreateExtractValue(slice, 0);
+		length = gen->builder.CreateExtractValue(slice, 1);
+	}
+	else if (var.second.elementType->isArrayTy() && !var.second.isPointer())
+	{
+		elementType = var.second.elementType->getArrayElementType();
+		data = var.first;
+		length = gen->builder.getInt64(var.second.elementType->getArrayNumElements());
+	}
+	else
+	{
+		std::cerr << "only arrays and slices can be sliced\n";
+		exit(1);
+	}
+
+	auto start = range->start ? gen->convert(range->start->codegen(scope, gen), gen->builder.getInt64Ty()) : gen->builder.getInt64(0);
+	auto end = range->end ? gen->convert(range->end->codegen(scope, gen), gen->builder.getInt64Ty()) : length;
+
+	if (gen->options.boundsCheck)
+		gen->trapUnless(gen->builder.CreateAnd(gen->builder.CreateICmpULE(start, end), gen->builder.CreateICmpULE(end, length)));
+
+	llvm::Value *slice = llvm::PoisonValue::get(gen->sliceType(elementType));
+	slice = gen->builder.CreateInsertValue(slice, gen->builder.CreateGEP(elementType, data, start), 0);
+	slice = gen->builder.CreateInsertValue(slice, gen->builder.CreateSub(end, start), 1);
+
+	return slice;
+}
+
+llvm::Value *VariableAccess::codegen(GScope *scope, Generator *gen)
+{
+	if (auto variant = gen->enumValue(this, scope))
+		return variant;
+
+	auto var = scope->getVar(varName);
+
+	// A register local has no storage to index into, except a pointer, whose value already is the address p[i] needs
+	bool registerBase = false;
+
+	if (scope->inRegister(varName))
+	{
+		if (indexes.empty() && !gen->inReferenceContext)
+			return var.first;
+
+		if (var.second.isPointer() && !indexes.empty() && dynamic_cast<ArrayIndex *>(indexes[0]))
+			registerBase = true;
+		else
+			var.first = gen->spill(varName, scope);
+	}
+
+	// The index expressions are always rvalues, even when the access itself is an assignment target
+	bool referenceContext = gen->inReferenceContext;
+	gen->inReferenceContext = false;
+
+	for (size_t i = 0; i < indexes.size(); ++i)
+	{
+		llvm::Type *elementType = var.second.elementType;
+		llvm::Type *sliceElement = var.second.isPointer() ? nullptr : gen->sliceElement(elementType);
+
+		if (auto range = dynamic_cast<SliceRange *>(indexes[i]))
+		{
+			if (i + 1 != indexes.size())
+			{
+				std::cerr << "a sub-slice of " << varName << " must be the last index, bind it to a variable first\n";
+				exit(1);
+			}
+
+			if (referenceContext)
+			{
+				std::cerr << "a sub-slice of " << varName << " can only be used as a value\n";
+				exit(1);
+			}
+
+			gen->inReferenceContext = referenceContext;
+			return subSlice(var, range, scope, gen);
+		}
+		else if (auto arrayIndex = dynamic_cast<ArrayIndex *>(indexes[i]))
+		{
+			auto indexValue = arrayIndex->expr->codegen(scope, gen);
+
+			// GEP indices are sign extended, an unsigned index is widened first so its top bit stays a magnitude
+			if (!gen->expressionType(arrayIndex->expr, scope).isSigned)
+				indexValue = gen->convert(indexValue, gen->builder.getInt64Ty(), false);
+
+			if (var.second.isPointer())
+			{
+				// p[i] indexes the memory p points to, without a bounds check since the length is unknown
+				GType pointee{elementType, var.second.depth - 1};
+				auto base = registerBase && i == 0 ? var.first : gen->builder.CreateLoad(var.second.type(gen->ctx), var.first);
+				var = {gen->builder.CreateGEP(pointee.type(gen->ctx), base, indexValue), pointee};
+			}
+			else if (sliceElement)
+			{
+				auto data = gen->builder.CreateLoad(llvm::PointerType::get(gen->ctx, 0), gen->builder.CreateStructGEP(elementType, var.first, 0));
+
+				if (gen->options.boundsCheck)
+					gen->boundsCheck(arrayIndex->expr, indexValue, gen->builder.CreateLoad(gen->builder.getInt64Ty(), gen->builder.CreateStructGEP(elementType, var.first, 1)), scope);
+
+				var = {gen->builder.CreateGEP(sliceElement, data, indexValue), GType{sliceElement, 0}};
+			}
+			else if (elementType->isArrayTy())
+			{
+				gen->boundsCheck(arrayIndex->expr, indexValue, gen->builder.getInt64(elementType->getArrayNumElements()), scope);
+
+				auto ptr = gen->builder.CreateGEP(elementType, var.first, {gen->builder.getInt32(0), indexValue});
+				var = {ptr, GType{elementType->getArrayElementType(), 0}};
+			}
+			else
+			{
+				std::cerr << "cannot index " << varName << ", only arrays, slices and pointers can be indexed\n";
+				exit(1);
+			}
+		}
+		else if (auto structField = dynamic_cast<StructField *>(indexes[i]))
+		{
+			if (sliceElement)
+			{
+				if (structField->fieldName != "len" && structField->fieldName != "ptr")
+				{
+					std::cerr << "slices only have the fields len and ptr\n";
+					exit(1);
+				}
+
+				bool isLength = structField->fieldName == "len";
+				var = {gen->builder.CreateStructGEP(elementType, var.first, isLength, varName + "." + structField->fieldName),
+					   isLength ? GType{gen->builder.getInt64Ty(), 0} : GType{sliceElement, 1}};
+				continue;
+			}
+
+			llvm::StructType *structType = llvm::cast<llvm::StructType>(elementType);
+
+			StructInfo info = gen->structInfo(structType);
+			unsigned int fieldIndex = info.getFieldIndex(structField->fieldName);
+
+			var.first = gen->builder.CreateStructGEP(
+				structType,
+				var.first,
+				fieldIndex,
+				varName + "." + structField->fieldName);
+
+			var.second = GType{structType->getElementType(fieldIndex), 0};
+		}
+	}
+
+	gen->inReferenceContext = referenceContext;
+
+	if (gen->inReferenceContext)
+	{
+		return var.first;
+	}
+
+	return gen->builder.CreateLoad(var.second.type(gen->ctx), var.first);
+}
+
+llvm::Value *UnaryExpr::codegen(GScope *scope, Generator *gen)
+{
+	switch (op.type)
+	{
+	case TOKEN_OPERATOR_MINUS:
+	{
+		auto val = expr->codegen(scope, gen);
+		if (!val)
+			return nullptr;
+		if (val->getType()->isFPOrFPVectorTy())
+			return gen->builder.CreateFNeg(val);
+		return gen->builder.CreateNeg(val);
+	}
+	case TOKEN_OPERATOR_NOT:
+	case TOKEN_OPERATOR_BIT_NOT:
+	{
+		auto val = expr->codegen(scope, gen);
+		if (!val)
+			return nullptr;
+		return gen->builder.CreateNot(val);
+	}
+	case TOKEN_POINTER:
+	{
+		auto val = expr->codegen(scope, gen);
+		auto ty = gen->expressionType(expr, scope);
+
+		if (gen->inReferenceContext)
+		{
+			if (dynamic_cast<Variable *>(expr))
+			{
+				return gen->builder.CreateLoad(ty.type(gen->ctx)->getPointerTo(), val);
+			}
+		}
+
+		GType loadedType{ty.elementType, ty.depth - 1};
+		return gen->builder.CreateLoad(loadedType.type(gen->ctx), val);
+	}
+	case TOKEN_REFERENCE:
+	{
+		gen->inReferenceContext = true;
+		auto val = expr->codegen(scope, gen);
+		if (!val)
+			return nullptr;
+		gen->inReferenceContext = false;
+
+		// Variables, elements and fields already are addresses in a reference context, anything else is spilled to a temporary
+		if (!dynamic_cast<Variable *>(expr) && !dynamic_cast<VariableAccess *>(expr))
+		{
+			auto ty = gen->expressionType(expr, scope);
+			auto alloc = gen->createScopedAlloca(ty.type(gen->ctx)->getPointerTo(), scope);
+			gen->builder.CreateStore(val, alloc);
+			return alloc;
+		}
+
+		return val;
+	}
+	default:
+		return nullptr;
+	}
+}
+
+llvm::Value *ArrayLiteral::codegen(GScope *scope, Generator *gen)
+{
+	std::vector<llvm::Value *> elements;
+
+	for (auto val : values)
+	{
+		elements.push_back(val->codegen(scope, gen));
+	}
+
+	auto type = llvm::ArrayType::get(elements[0]->getType(), elements.size());
+	auto alloc = gen->createScopedAlloca(type, scope);
+
+	for (size_t i = 0; i < elements.size(); ++i)
+	{
+		auto ptr = gen->builder.CreateGEP(type, alloc, {gen->builder.getInt32(0), gen->builder.getInt32(i)});
+		gen->builder.CreateStore(elements[i], ptr);
+	}
+
+	return gen->builder.CreateLoad(type, alloc);
+}
+
+// Returned as any struct of their size, so small tuples come back in registers
+llvm::StructType *Generator::tupleType(const std::vector<GType> &elements)
+{
+	std::vector<std::tuple<llvm::Type *, size_t, bool>> key;
+	std::vector<llvm::Type *> types;
+
+	for (auto element : elements)
+	{
+		key.push_back({element.elementType, element.depth, element.isSigned});
+		types.push_back(element.type(ctx));
+	}
+
+	auto &tuple = tupleTypes[key];
+
+	if (!tuple)
+	{
+		tuple = llvm::StructType::create(ctx, types, "tuple");
+		tupleElements[tuple] = elements;
+	}
+
+	return tuple;
+}
+
+llvm::StructType *Generator::sliceType(llvm::Type *element)
+{
+	auto &slice = sliceTypes[element];
+
+	if (!slice)
+	{
+		slice = llvm::StructType::create(ctx, {llvm::PointerType::get(ctx, 0), builder.getInt64Ty()}, "slice");
+		sliceElements[slice] = element;
+	}
+
+	return slice;
+}
+
+llvm::Type *Generator::sliceElement(llvm::Type *type)
+{
+	auto slice = llvm::dyn_cast<llvm::StructType>(type);
+
+	return slice && sliceElements.count(slice) ? sliceElements[slice] : nullptr;
+}
+
+llvm::Value *Generator::codegenAs(ASTNode *expr, GScope *scope, llvm::Type *target)
+{
+	// A struct literal is built as the struct it is stored as, which supplies the type arguments it leaves out
+	if (auto literal = dynamic_cast<StructLiteral *>(expr))
+	{
+		literalTarget = target;
+		return coerce(literal->codegen(scope, this), target);
+	}
+
+	auto element = sliceElement(target);
+	GType source = expressionType(expr, scope);
+
+	// Arrays, and pointers to arrays, coerce to slices that borrow their storage
+	if (element && source.elementType->isArrayTy() && source.depth <= 1)
+	{
+		if (source.elementType->getArrayElementType() != element)
+		{
+			std::cerr << "array element type does not match the slice element type\n";
+			exit(1);
+		}
+
+		llvm::Value *data;
+
+		if (source.depth == 1)
+		{
+			data = expr->codegen(scope, this);
+		}
+		else if (dynamic_cast<Variable *>(expr) || dynamic_cast<VariableAccess *>(expr))
+		{
+			inReferenceContext = true;
+			data = expr->codegen(scope, this);
+			inReferenceContext = false;
+		}
+		else
+		{
+			data = createEntryAlloca(source.elementType);
+			builder.CreateStore(expr->codegen(scope, this), data);
+		}
+
+		llvm::Value *slice = llvm::PoisonValue::get(target);
+		slice = builder.CreateInsertValue(slice, data, 0);
+		slice = builder.CreateInsertValue(slice, builder.getInt64(source.elementType->getArrayNumElements()), 1);
+
+		return slice;
+	}
+
+	// Tuples convert element by element, e.g. the literal (0, true) returned as (i64, bool)
+	auto targetTuple = llvm::dyn_cast<llvm::StructType>(target);
+
+	if (targetTuple && tupleElements.count(targetTuple) && target != source.type(ctx))
+	{
+		auto sourceTuple = llvm::dyn_cast<llvm::StructType>(source.elementType);
+		auto literal = dynamic_cast<TupleLiteral *>(expr);
+		size_t count = 0;
+
+		if (literal)
+			count = literal->values.size();
+		else if (!source.isPointer() && sourceTuple && tupleElements.count(sourceTuple))
+			count = sourceTuple->getNumElements();
+
+		if (count != targetTuple->getNumElements())
+		{
+			std::cerr << "expected a tuple of " << targetTuple->getNumElements() << " values\n";
+			exit(1);
+		}
+
+		auto value = literal ? nullptr : expr->codegen(scope, this);
+		llvm::Value *tuple = llvm::PoisonValue::get(target);
+
+		for (unsigned i = 0; i < count; ++i)
+		{
+			auto fieldType = targetTuple->getElementType(i);
+			auto element = literal ? codegenAs(literal->values[i], scope, fieldType) : coerce(builder.CreateExtractValue(value, i), fieldType, tupleElements[sourceTuple][i].isSigned);
+			tuple = builder.CreateInsertValue(tuple, element, i);
+		}
+
+		return tuple;
+	}
+
+	// Array literals build their elements at the declared element type too, e.g. [1, 2, 3] stored as [i64; 3]
+	auto arrayLiteral = dynamic_cast<ArrayLiteral *>(expr);
+
+	if (arrayLiteral && target->isArrayTy() && target != source.type(ctx) && target->getArrayNumElements() == arrayLiteral->values.size())
+	{
+		llvm::Value *array = llvm::PoisonValue::get(target);
+
+		for (size_t i = 0; i < arrayLiteral->values.size(); ++i)
+			array = builder.CreateInsertValue(array, codegenAs(arrayLiteral->values[i], scope, target->getArrayElementType()), i);
+
+		return array;
+	}
+
+	return coerce(expr->codegen(scope, this), target, source.isSigned);
+}
+
+StructInfo &Generator::structInfo(llvm::StructType *structType)
+{
+	auto fullName = structType->getName();
+	size_t colonPos = fullName.find(':');
+	auto module = fullName.substr(0, colonPos);
+	auto name = fullName.substr(colonPos + 1);
+
+	return structSymbols[module.str()][name.str()];
+}
+
+// How a type argument is spelled in the name of an instance, e.g. the i64 of max[i64]
+std::string Generator::typeName(GType type)
+{
+	std::string name(type.depth, '^');
+	llvm::Type *element = type.elementType;
+
+	if (type.isReadOnly && type.depth)
+		name.insert(1, "const ");
+
+	if (element->isIntegerTy(1))
+		return name + "bool";
+
+	if (element->isIntegerTy())
+		return name + (type.isSigned ? "i" : "u") + std::to_string(element->getIntegerBitWidth());
+
+	if (element->isFloatTy())
+		return name + "f32";
+
+	if (element->isDoubleTy())
+		return name + "f64";
+
+	if (auto array = llvm::dyn_cast<llvm::ArrayType>(element))
+		return name + "[" + typeName(GType{array->getElementType(), 0, type.isSigned}) + "; " + std::to_string(array->getNumElements()) + "]";
+
+	if (auto vector = llvm::dyn_cast<llvm::FixedVectorType>(element))
+		return name + "vec[" + typeName(GType{vector->getElementType(), 0, type.isSigned}) + "; " + std::to_string(vector->getNumElements()) + "]";
+
+	if (auto slice = sliceElement(element))
+		return name + "[]" + typeName(GType{slice, 0, type.isSigned});
+
+	if (auto structType = llvm::dyn_cast<llvm::StructType>(element); structType && tupleElements.count(structType))
+	{
+		std::string elements;
+
+		for (auto &tupleElement : tupleElements[structType])
+			elements += (elements.empty() ? "" : ", ") + typeName(tupleElement);
+
+		return name + "(" + elements + ")";
+	}
+
+	// Structs keep their module, so equally named structs of two modules give distinct instances
+	if (auto structType = llvm::dyn_cast<llvm::StructType>(element))
+		return name + structType->getName().str();
+
+	std::string printed;
+	llvm::raw_string_ostream os(printed);
+	element->print(os);
+
+	return name + os.str();
+}
+
+std::string Generator::instanceName(const std::string &name, const std::vector<GType> &args)
+{
+	std::string list;
+
+	for (auto &arg : args)
+		list += (list.empty() ? "" : ", ") + typeName(arg);
+
+	return name + "[" + list + "]";
+}
+
+// Matches a declared type that uses type parameters against the type of a value, binding the parameters it reaches.
+// Parts that do not line up bind nothing, the value is then rejected when it is converted to the instance's type
+static void inferTypes(Type *pattern, GType actual, const std::string &module, const std::vector<std::string> &params,
+					   std::map<std::string, GType> &bindings, bool keepBound, const std::string &name, Generator *gen)
+{
+	if (!actual.elementType)
+		return;
+
+	if (auto st = dynamic_cast<StructType *>(pattern))
+	{
+		if (st->typeArgs.empty() && st->moduleName == module && std::find(params.begin(), params.end(), st->name) != params.end())
+		{
+			if (actual.depth < st->pointerLevel)
+				return;
+
+			GType bound{actual.elementType, actual.depth - st->pointerLevel, actual.isSigned};
+			bound.isReadOnly = actual.isReadOnly && bound.depth && !st->pointerLevel;
+			auto key = module + ":" + st->name;
+			auto existing = bindings.find(key);
+
+			if (existing == bindings.end())
+			{
+				bindings[key] = bound;
+			}
+			else if (!keepBound && gen->typeName(existing->second) != gen->typeName(bound))
+			{
+				std::cerr << "conflicting types for " << st->name << " of " << name << ": " << gen->typeName(existing->second)
+						  << " and " << gen->typeName(bound) << "\n";
+				exit(1);
+			}
+
+			return;
+		}
+
+		// ^List[T] against ^List[i64] binds T to i64
+		auto structType = llvm::dyn_cast<llvm::StructType>(actual.elementType);
+
+		if (structType && actual.depth == st->pointerLevel && gen->structInstances.count(structType))
+		{
+			auto &args = gen->structInstances[structType].second;
+
+			for (size_t i = 0; i < st->typeArgs.size() && i < args.size(); ++i)
+				inferTypes(st->typeArgs[i], args[i], module, params, bindings, keepBound, name, gen);
+		}
+
+		return;
+	}
+
+	if (pattern->pointerLevel != actual.depth)
+		return;
+
+	if (auto array = dynamic_cast<ArrayType *>(pattern); array && actual.elementType->isArrayTy())
+	{
+		inferTypes(array->type, GType{actual.elementType->getArrayElementType(), 0, actual.isSigned}, module, params, bindings, keepBound, name, gen);
+	}
+	else if (auto slice = dynamic_cast<SliceType *>(pattern); slice && gen->sliceElement(actual.elementType))
+	{
+		inferTypes(slice->type, GType{gen->sliceElement(actual.elementType), 0, actual.isSigned}, module, params, bindings, keepBound, name, gen);
+	}
+	else if (auto tuple = dynamic_cast<TupleType *>(pattern))
+	{
+		auto structType = llvm::dyn_cast<llvm::StructType>(actual.elementType);
+
+		if (!structType || !gen->tupleElements.count(structType) || gen->tupleElements[structType].size() != tuple->types.size())
+			return;
+
+		for (size_t i = 0; i < tuple->types.size(); ++i)
+			inferTypes(tuple->types[i], gen->tupleElements[structType][i], module, params, bindings, keepBound, name, gen);
+	}
+}
+
+// The type arguments of a generic function or struct, as written or else inferred from the values given for its
+// parameters or fields. An integer literal has no type of its own, so it only binds what no other value does
+std::vector<GType> Generator::typeArguments(const std::string &module, const std::string &name, const std::vector<std::string> &params,
+										   const std::vector<Type *> &explicitArgs, const std::vector<std::pair<Type *, ASTNode *>> &values, GScope *scope)
+{
+	std::vector<GType> args;
+
+	if (!explicitArgs.empty())
+	{
+		if (explicitArgs.size() != params.size())
+		{
+			std::cerr << name << " takes " << params.size() << " type arguments, " << explicitArgs.size() << " were given\n";
+			exit(1);
+		}
+
+		for (auto arg : explicitArgs)
+			args.push_back(typeInfo(arg));
+
+		return args;
+	}
+
+	std::map<std::string, GType> bindings;
+
+	for (bool literals : {false, true})
+	{
+		for (auto &[pattern, value] : values)
+		{
+			if ((dynamic_cast<IntLiteral *>(value) != nullptr) == literals)
+				inferTypes(pattern, expressionType(value, scope), module, params, bindings, literals, name, this);
+		}
+	}
+
+	for (auto &param : params)
+	{
+		if (!bindings.count(module + ":" + param))
+		{
+			std::cerr << "cannot infer type parameter " << param << " of " << name << ", pass it explicitly as " << name << "[...]\n";
+			exit(1);
+		}
+
+		args.push_back(bindings[module + ":" + param]);
+	}
+
+	return args;
+}
+
+// One named struct per generic struct and distinct list of type arguments, e.g. main:Pair[i64, bool]
+llvm::StructType *Generator::instantiateStruct(StructDefinition *def, const std::vector<GType> &args)
+{
+	if (args.size() != def->typeParams.size())
+	{
+		std::cerr << def->name << " takes " << def->typeParams.size() << " type arguments, " << args.size() << " were given\n";
+		exit(1);
+	}
+
+	std::string name = instanceName(def->name, args);
+	StructInfo &info = structSymbols[def->moduleName][name];
+
+	if (info.type)
+		return info.type;
+
+	// Created before its fields, which may point back to it, e.g. next: ^Node[T]
+	info.type = llvm::StructType::create(ctx, def->moduleName + ":" + name);
+	info.fieldNames = def->fieldNames;
+	structInstances[info.type] = {def, args};
+
+	std::map<std::string, GType> bindings;
+
+	for (size_t i = 0; i < args.size(); ++i)
+		bindings[def->moduleName + ":" + def->typeParams[i]] = args[i];
+
+	enterInstance(name);
+	std::swap(typeBindings, bindings);
+
+	std::vector<llvm::Type *> memberTypes;
+	std::vector<bool> fieldSigned;
+
+	for (auto type : def->fieldTypes)
+	{
+		auto ty = typeInfo(type);
+		memberTypes.push_back(ty.type(ctx));
+		fieldSigned.push_back(ty.isSigned);
+	}
+
+	std::swap(typeBindings, bindings);
+	--instanceDepth;
+
+	info.type->setBody(memberTypes);
+	info.fieldSigned = fieldSigned;
+
+	return info.type;
+}
+
+// The struct a literal builds. A generic one takes its type arguments from the literal, else from the instance it is
+// stored as, else from its field values
+StructInfo &Generator::literalInfo(StructLiteral *literal, GScope *scope, llvm::Type *target)
+{
+	auto generics = genericStructs.find(literal->moduleName);
+
+	if (generics == genericStructs.end() || !generics->second.count(literal->name))
+		return structSymbols[literal->moduleName][literal->name];
+
+	StructDefinition *def = generics->second[literal->name];
+	auto targetStruct = llvm::dyn_cast_or_null<llvm::StructType>(target);
+
+	if (literal->typeArgs.empty() && targetStruct && structInstances.count(targetStruct) && structInstances[targetStruct].first == def)
+		return structInfo(targetStruct);
+
+	std::vector<std::pair<Type *, ASTNode *>> values;
+
+	for (size_t i = 0; i < literal->fieldNames.size(); ++i)
+	{
+		auto field = std::find(def->fieldNames.begin(), def->fieldNames.end(), literal->fieldNames[i]);
+
+		if (field != def->fieldNames.end())
+			values.push_back({def->fieldTypes[field - def->fieldNames.begin()], literal->fieldExprs[i]});
+	}
+
+	auto args = typeArguments(def->moduleName, def->name, def->typeParams, literal->typeArgs, values, scope);
+
+	return structInfo(instantiateStruct(def, args));
+}
+
+// The function a call goes to. A generic callee is instantiated for the call's type arguments the first time they are
+// needed in the current module, later calls with the same arguments reuse the instance
+llvm::Function *Generator::callee(FunctionCall *call, GScope *scope)
+{
+	auto symbols = functionSymbols.find(call->moduleName);
+
+	if (symbols != functionSymbols.end() && symbols->second.count(call->name) && call->typeArgs.empty())
+		return symbols->second[call->name];
+
+	auto generics = genericFunctions.find(call->moduleName);
+
+	if (generics == genericFunctions.end() || !generics->second.count(call->name))
+		return nullptr;
+
+	FunctionDefinition *def = generics->second[call->name];
+
+	if (!def->body)
+	{
+		std::cerr << "generic function " << def->name << " needs a body\n";
+		exit(1);
+	}
+
+	std::vector<std::pair<Type *, ASTNode *>> values;
+
+	for (size_t i = 0; i < call->params.size() && i < def->paramTypes.size(); ++i)
+		values.push_back({def->paramTypes[i], call->params[i]});
+
+	auto args = typeArguments(def->moduleName, def->name, def->typeParams, call->typeArgs, values, scope);
+	std::string name = instanceName(def->name, args);
+
+	if (functionSymbols[def->moduleName].count(name))
+		return functionSymbols[def->moduleName][name];
+
+	std::map<std::string, GType> bindings;
+
+	for (size_t i = 0; i < args.size(); ++i)
+		bindings[def->moduleName + ":" + def->typeParams[i]] = args[i];
+
+	std::swap(typeBindings, bindings);
+	auto function = declareFunction(def, name);
+	std::swap(typeBindings, bindings);
+
+	// Every module or partition that uses an instance generates its own copy, the linker keeps one
+	function->setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+	pendingInstances.push_back({def, bindings, function, instanceDepth + 1});
+
+	return function;
+}
+
+unsigned int StructInfo::getFieldIndex(std::string fieldName)
+{
+	int fieldIndex = -1;
+
+	for (unsigned i = 0; i < fieldNames.size(); i++)
+	{
+		if (fieldNames[i] == fieldName)
+		{
+			fieldIndex = i;
+			break;
+		}
+	}
+
+	return fieldIndex;
+}
+
+llvm::Value *StructLiteral::codegen(GScope *scope, Generator *gen)
+{
+	llvm::Type *target = gen->literalTarget;
+	gen->literalTarget = nullptr;
+
+	StructInfo info = gen->literalInfo(this, scope, target);
+
+	if (!info.type)
+	{
+		std::cerr << "Struct type does not exist!\n";
+	}
+
+	llvm::Value *alloc = gen->createScopedAlloca(info.type, scope);
+
+	for (size_t i = 0; i < fieldNames.size(); ++i)
+	{
+		unsigned int fieldIndex = info.getFieldIndex(fieldNames[i]);
+		gen->checkConstConversion(fieldExprs[i], GType{info.type->getElementType(fieldIndex), 0}, scope, "field " + fieldNames[i]);
+		llvm::Value *fieldValue = gen->codegenAs(fieldExprs[i], scope, info.type->getElementType(fieldIndex));
+
+		llvm::Value *fieldPtr = gen->builder.CreateStructGEP(
+			info.type,
+			alloc,
+			fieldIndex,
+			"structfield." + fieldNames[i]);
+
+		gen->builder.CreateStore(fieldValue, fieldPtr);
+	}
+
+	return gen->builder.CreateLoad(info.type, alloc);
+}
+
+// Binds a variable, replacing an earlier one of the same name. An immutable integer with a constant value gets its range
+// recorded, so indexing with it needs no bounds check
+static void declareLocal(GScope *scope, const std::string &name, llvm::Value *storage, GType type, bool isMutable, llvm::Value *value)
+{
+	scope->variables[name] = std::pair{storage, type};
+	scope->immutables.erase(name);
+	scope->ranges.erase(name);
+	scope->registers.erase(name);
+
+	if (isMutable)
+		return;
+
+	scope->immutables.insert(name);
+
+	if (auto constant = llvm::dyn_cast_or_null<llvm::ConstantInt>(value); constant && constant->getBitWidth() <= 64)
+	{
+		int64_t v = type.isSigned ? constant->getSExtValue() : (int64_t)constant->getZExtValue();
+		scope->ranges[name] = {v, v};
+	}
+}
+
+// Without mem2reg every use of a stack slot is a load. At -O0 an immutable scalar is bound to its value instead, and only
+// gets a slot if its address is taken
+static bool declareRegister(GScope *scope, const std::string &name, llvm::Value *value, GType type, bool isMutable, Generator *gen)
+{
+	auto llvmType = value->getType();
+
+	if (gen->options.optLevel > 0 || isMutable || !(llvmType->isIntegerTy() || llvmType->isFloatingPointTy() || llvmType->isPointerTy()))
+		return false;
+
+	if (llvm::isa<llvm::Instruction>(value) && !value->hasName())
+		value->setName(name);
+
+	declareLocal(scope, name, value, type, false, value);
+	scope->registers.insert(name);
+
+	return true;
+}
+
+// Literals, enum variants, operators and casts of other scalar constants, the expressions the builder folds without emitting code
+static bool isConstantExpression(ASTNode *expr, GScope *scope, Generator *gen)
+{
+	if (dynamic_cast<IntLiteral *>(expr) || dynamic_cast<CharLiteral *>(expr) || dynamic_cast<BoolLiteral *>(expr) || gen->enumInfo(expr, scope))
+		return true;
+
+	if (auto variable = dynamic_cast<Variable *>(expr))
+	{
+		auto global = llvm::dyn_cast_or_null<llvm::GlobalVariable>(scope->getVar(variable->name).first);
+		return global && global->isConstant() && !global->getValueType()->isAggregateType();
+	}
+
+	if (auto unary = dynamic_cast<UnaryExpr *>(expr))
+		return unary->op.type != TOKEN_POINTER && unary->op.type != TOKEN_REFERENCE && isConstantExpression(unary->expr, scope, gen);
+
+	if (auto binary = dynamic_cast<BinaryExpr *>(expr))
+		return isConstantExpression(binary->lhs, scope, gen) && isConstantExpression(binary->rhs, scope, gen);
+
+	if (auto cast = dynamic_cast<Cast *>(expr))
+		return isConstantExpression(cast->expr, scope, gen);
+
+	return false;
+}
+
+llvm::Constant *Generator::constantInitializer(ASTNode *expr, GType type, GScope *scope)
+{
+	auto target = type.type(ctx);
+
+	if (auto array = dynamic_cast<ArrayLiteral *>(expr); array && (target->isArrayTy() || target->isVectorTy()))
+	{
+		auto elementType = target->isArrayTy() ? target->getArrayElementType() : llvm::cast<llvm::VectorType>(target)->getElementType();
+		uint64_t count = target->isArrayTy() ? target->getArrayNumElements() : llvm::cast<llvm::FixedVectorType>(target)->getNumElements();
+
+		if (array->values.size() != count)
+		{
+			std::cerr << "array literal has " << array->values.size() << " elements but the type has " << count << "\n";
+			exit(1);
+		}
+
+		std::vector<llvm::Constant *> elements;
+
+		for (auto value : array->values)
+			elements.push_back(constantInitializer(value, GType{elementType, 0, type.isSigned}, scope));
+
+		if (target->isVectorTy())
+			return llvm::ConstantVector::get(elements);
+
+		return llvm::ConstantArray::get(llvm::cast<llvm::ArrayType>(target), elements);
+	}
+
+	if (auto literal = dynamic_cast<StructLiteral *>(expr); literal && target->isStructTy())
+	{
+		StructInfo &info = literalInfo(literal, scope, target);
+		std::vector<llvm::Constant *> fields;
+
+		// Fields left out of the literal are zero
+		for (auto fieldType : info.type->elements())
+			fields.push_back(llvm::Constant::getNullValue(fieldType));
+
+		for (size_t i = 0; i < literal->fieldNames.size(); ++i)
+		{
+			unsigned int fieldIndex = info.getFieldIndex(literal->fieldNames[i]);
+			fields[fieldIndex] = constantInitializer(literal->fieldExprs[i], GType{info.type->getElementType(fieldIndex), 0, info.fieldSigned[fieldIndex]}, scope);
+		}
+
+		return llvm::ConstantStruct::get(info.type, fields);
+	}
+
+	if (auto string = dynamic_cast<StringLiteral *>(expr))
+		return builder.CreateGlobalStringPtr(string->value, "", 0, module.get());
+
+	if (isConstantExpression(expr, scope, this))
+	{
+		if (auto constant = llvm::dyn_cast<llvm::Constant>(codegenAs(expr, scope, target)))
+			return constant;
+	}
+
+	std::cerr << "module level initializers must be constant expressions\n";
+	exit(1);
+}
+
+// Name.Variant or module:Name.Variant, unless a variable of that name is in scope
+EnumInfo *Generator::enumInfo(ASTNode *expr, GScope *scope)
+{
+	auto access = dynamic_cast<VariableAccess *>(expr);
+
+	if (!access || access->indexes.size() != 1 || !dynamic_cast<StructField *>(access->indexes[0]) || scope->getVar(access->varName).first)
+		return nullptr;
+
+	std::string moduleName = parser->pathToModule[currentFile->path];
+	std::string name = access->varName;
+
+	if (auto colon = name.find(':'); colon != std::string::npos)
+	{
+		moduleName = name.substr(0, colon);
+		name = name.substr(colon + 1);
+	}
+
+	auto module = enumSymbols.find(moduleName);
+
+	if (module == enumSymbols.end() || !module->second.count(name))
+		return nullptr;
+
+	return &module->second[name];
+}
+
+llvm::ConstantInt *Generator::enumValue(ASTNode *expr, GScope *scope)
+{
+	auto info = enumInfo(expr, scope);
+
+	if (!info)
+		return nullptr;
+
+	auto access = static_cast<VariableAccess *>(expr);
+	auto variant = static_cast<StructField *>(access->indexes[0])->fieldName;
+
+	if (!info->values.count(variant))
+	{
+		std::cerr << "enum " << access->varName << " has no variant " << variant << "\n";
+		exit(1);
+	}
+
+	return llvm::ConstantInt::get(llvm::cast<llvm::IntegerType>(info->type.elementType), info->values[variant], info->type.isSigned);
+}
+
+llvm::Value *Match::codegen(GScope *scope, Generator *gen)
+{
+	auto func = gen->builder.GetInsertBlock()->getParent();
+	GType type = gen->expressionType(value, scope);
+	auto integerType = llvm::dyn_cast<llvm::IntegerType>(type.type(gen->ctx));
+
+	if (!integerType)
+	{
+		std::cerr << "match expects an integer or enum value\n";
+		exit(1);
+	}
+
+	// Patterns are folded before the switch is emitted, they never produce code
+	std::vector<std::vector<llvm::ConstantInt *>> cases;
+	std::set<llvm::ConstantInt *> seen;
+	size_t elseArms = 0;
+
+	for (auto &arm : arms)
+	{
+		cases.emplace_back();
+		elseArms += arm.first.empty();
+
+		for (auto pattern : arm.first)
+		{
+			auto caseValue = isConstantExpression(pattern, scope, gen) ? llvm::dyn_cast<llvm::ConstantInt>(gen->codegenAs(pattern, scope, integerType)) : nullptr;
+
+			if (!caseValue)
+			{
+				std::cerr << "match patterns must be integer constants or enum variants\n";
+				exit(1);
+			}
+
+			if (!seen.insert(caseValue).second)
+			{
+				std::cerr << "match pattern " << (type.isSigned ? caseValue->getSExtValue() : (int64_t)caseValue->getZExtValue()) << " appears more than once\n";
+				exit(1);
+			}
+
+			cases.back().push_back(caseValue);
+		}
+	}
+
+	if (elseArms > 1)
+	{
+		std::cerr << "match has more than one else arm\n";
+		exit(1);
+	}
+
+	auto condition = gen->builder.CreateIntCast(value->codegen(scope, gen), integerType, type.isSigned);
+	auto mergeBB = llvm::BasicBlock::Create(gen->ctx, "match.end", func);
+
+	// Without an else arm a value matching no pattern skips the match
+	auto switchInst = gen->builder.CreateSwitch(condition, mergeBB, seen.size());
+
+	for (size_t i = 0; i < arms.size(); ++i)
+	{
+		auto armBB = llvm::BasicBlock::Create(gen->ctx, arms[i].first.empty() ? "match.else" : "match.arm", func, mergeBB);
 
-			gen->builder.CreateCondBr(condValue, thenBB, elseBB);
-		}
-		else
-		{
-			gen->builder.CreateBr(thenBB);
-		}
+		if (arms[i].first.empty())
+			switchInst->setDefaultDest(armBB);
 
-		gen->builder.SetInsertPoint(thenBB);
+		for (auto caseValue : cases[i])
+			switchInst->addCase(caseValue, armBB);
 
-		{
-			GScope *thenScope = new GScope(scope);
-			condition.second->codegen(thenScope, gen);
-			gen->builder.CreateBr(mergeBB);
-		}
+		gen->builder.SetInsertPoint(armBB);
+		arms[i].second->codegen(scope, gen);
 
-		gen->builder.SetInsertPoint(elseBB);
+		if (!gen->builder.GetInsertBlock()->getTerminator())
+			gen->builder.CreateBr(mergeBB);
 	}
 
-	gen->builder.CreateBr(mergeBB);
 	gen->builder.SetInsertPoint(mergeBB);
 
 	return nullptr;
 }
 
-llvm::Value *Assign::codegen(GScope *scope, Generator *gen)
+llvm::Value *GlobalDecl::codegen(GScope *scope, Generator *gen)
 {
-	gen->inReferenceContext = true;
-	auto lvalue = lhs->codegen(scope, gen);
-	gen->inReferenceContext = false;
+	auto ty = gen->typeInfo(type);
+	auto llvmType = ty.type(gen->ctx);
 
-	auto rvalue = rhs->codegen(scope, gen);
-	return gen->builder.CreateStore(rvalue, lvalue);
+	// Initializers fold to constants, there is no function to emit code into
+	gen->builder.ClearInsertionPoint();
+
+	// A zero initializer puts the variable in .bss, a constant one in .rodata and any other in .data
+	llvm::Constant *initializer = expr ? gen->constantInitializer(expr, ty, scope) : llvm::Constant::getNullValue(llvmType);
+	auto global = new llvm::GlobalVariable(*gen->module, llvmType, isConstant, llvm::GlobalValue::InternalLinkage, initializer, varName);
+
+	if (isConstant)
+		global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+
+	declareLocal(scope, varName, global, ty, !isConstant, initializer);
+
+	return global;
 }
 
-llvm::Value *VariableAccess::codegen(GScope *scope, Generator *gen)
+// The module level variables of another jolt module, declared in the current LLVM module. Their definitions are
+// exported under a hidden <module>.<name>, like -fpartition-size does
+GScope *Generator::importGlobals(const std::string &moduleName)
 {
-	auto var = scope->getVar(varName);
+	GScope *scope = new GScope(nullptr);
 
-	for (auto &index : indexes)
+	for (auto &global : moduleGlobals[moduleName])
 	{
-		if (auto arrayIndex = dynamic_cast<ArrayIndex *>(index))
+		std::string symbol = moduleName + "." + global.name;
+
+		if (global.definition && global.definition->hasLocalLinkage())
 		{
-			auto indexValue = arrayIndex->expr->codegen(scope, gen);
+			global.definition->setLinkage(llvm::GlobalValue::ExternalLinkage);
+			global.definition->setVisibility(llvm::GlobalValue::HiddenVisibility);
+			global.definition->setName(symbol);
+		}
 
-			auto ptr = gen->builder.CreateGEP(var.second.elementType, var.first, {gen->builder.getInt32(0), indexValue});
+		auto declaration = module->getGlobalVariable(symbol, true);
 
-			if (var.second.elementType->isArrayTy())
-			{
-				auto newType = var.second.elementType->getArrayElementType();
-				var.first = ptr;
-				var.second.elementType = newType;
-			}
-		}
-		else if (auto structField = dynamic_cast<StructField *>(index))
+		if (!declaration)
 		{
-			llvm::StructType *structType = llvm::cast<llvm::StructType>(var.second.elementType);
-
-			auto fullName = structType->getName();
-			size_t colonPos = fullName.find(':');
-			auto module = fullName.substr(0, colonPos);
-			auto name = fullName.substr(colonPos + 1);
+			auto linkage = global.value ? llvm::GlobalValue::AvailableExternallyLinkage : llvm::GlobalValue::ExternalLinkage;
+			declaration = new llvm::GlobalVariable(*module, global.type.type(ctx), global.isConstant, linkage, global.value, symbol);
+			declaration->setVisibility(llvm::GlobalValue::HiddenVisibility);
+		}
 
-			StructInfo info = gen->structSymbols[module.str()][name.str()];
-			unsigned int fieldIndex = info.getFieldIndex(structField->fieldName);
+		declareLocal(scope, global.name, declaration, global.type, !global.isConstant, global.value);
+	}
 
-			var.first = gen->builder.CreateStructGEP(
-				structType,
-				var.first,
-				fieldIndex,
-				varName + "." + structField->fieldName);
+	return scope;
+}
 
-			var.second.elementType = structType->getElementType(fieldIndex);
-		}
-	}
+llvm::Value *VariableDecl::codegen(GScope *scope, Generator *gen)
+{
+	auto ty = gen->typeInfo(type);
+	gen->checkConstConversion(expr, ty, scope, "let " + varName);
 
-	if (gen->inReferenceContext)
+	if (gen->returnsIndirectly(expr, ty.type(gen->ctx), scope))
 	{
-		return var.first;
+		// The call returns through a hidden pointer, so it is given the variable itself instead of a temporary
+		auto alloc = gen->createScopedAlloca(ty.type(gen->ctx), scope, varName);
+		gen->sretDestination = alloc;
+		expr->codegen(scope, gen);
+
+		declareLocal(scope, varName, alloc, ty, isMutable, nullptr);
+		return alloc;
 	}
 
-	return gen->builder.CreateLoad(var.second.elementType, var.first);
+	auto val = gen->codegenAs(expr, scope, ty.type(gen->ctx));
+
+	if (declareRegister(scope, varName, val, ty, isMutable, gen))
+		return val;
+
+	auto alloc = gen->createScopedAlloca(ty.type(gen->ctx), scope, varName);
+
+	gen->builder.CreateStore(val, alloc);
+	declareLocal(scope, varName, alloc, ty, isMutable, val);
+
+	return alloc;
 }
 
-llvm::Value *UnaryExpr::codegen(GScope *scope, Generator *gen)
+// Built in registers, a tuple only reaches memory when it is stored
+llvm::Value *TupleLiteral::codegen(GScope *scope, Generator *gen)
 {
-	switch (op.type)
-	{
-	case TOKEN_OPERATOR_MINUS:
+	auto type = gen->expressionType(this, scope).elementType;
+	llvm::Value *tuple = llvm::PoisonValue::get(type);
+
+	for (size_t i = 0; i < values.size(); ++i)
+		tuple = gen->builder.CreateInsertValue(tuple, values[i]->codegen(scope, gen), i);
+
+	return tuple;
+}
+
+llvm::Value *Destructure::codegen(GScope *scope, Generator *gen)
+{
+	GType type = gen->expressionType(expr, scope);
+	auto tuple = llvm::dyn_cast_or_null<llvm::StructType>(type.elementType);
+
+	if (type.isPointer() || !tuple || !gen->tupleElements.count(tuple))
 	{
-		auto val = expr->codegen(scope, gen);
-		if (!val)
-			return nullptr;
-		return gen->builder.CreateNeg(val);
+		std::cerr << "let (...) expects a tuple value\n";
+		exit(1);
 	}
-	case TOKEN_OPERATOR_NOT:
+
+	auto &elements = gen->tupleElements[tuple];
+
+	if (names.size() != elements.size())
 	{
-		auto val = expr->codegen(scope, gen);
-		if (!val)
-			return nullptr;
-		return gen->builder.CreateNot(val);
+		std::cerr << "cannot destructure a tuple of " << elements.size() << " values into " << names.size() << " names\n";
+		exit(1);
 	}
-	case TOKEN_POINTER:
-	{
-		auto val = expr->codegen(scope, gen);
-		auto ty = gen->expressionType(expr, scope);
 
-		if (gen->inReferenceContext)
-		{
-			if (dynamic_cast<Variable *>(expr))
-			{
-				return gen->builder.CreateLoad(ty.type(gen->ctx)->getPointerTo(), val);
-			}
-		}
+	auto value = expr->codegen(scope, gen);
 
-		GType loadedType{ty.elementType, ty.depth - 1};
-		return gen->builder.CreateLoad(loadedType.type(gen->ctx), val);
-	}
-	case TOKEN_REFERENCE:
+	for (size_t i = 0; i < names.size(); ++i)
 	{
-		gen->inReferenceContext = true;
-		auto val = expr->codegen(scope, gen);
-		if (!val)
-			return nullptr;
-		gen->inReferenceContext = false;
+		if (names[i] == "_")
+			continue;
 
-		if (!dynamic_cast<Variable *>(expr))
-		{
-			auto ty = gen->expressionType(expr, scope);
-			auto alloc = gen->builder.CreateAlloca(ty.type(gen->ctx)->getPointerTo());
-			gen->builder.CreateStore(val, alloc);
-			return alloc;
-		}
+		auto element = gen->builder.CreateExtractValue(value, i);
 
-		return val;
-	}
-	default:
-		return nullptr;
+		if (declareRegister(scope, names[i], element, elements[i], isMutable, gen))
+			continue;
+
+		auto alloc = gen->createScopedAlloca(element->getType(), scope, names[i]);
+
+		gen->builder.CreateStore(element, alloc);
+		declareLocal(scope, names[i], alloc, elements[i], isMutable, element);
 	}
+
+	return nullptr;
 }
 
-llvm::Value *ArrayLiteral::codegen(GScope *scope, Generator *gen)
+llvm::Value *Return::codegen(GScope *scope, Generator *gen)
 {
-	std::vector<llvm::Value *> elements;
+	auto func = gen->builder.GetInsertBlock()->getParent();
+	const FunctionABI &abi = gen->functionABIs[func];
 
-	for (auto val : values)
+	if (expr)
+		gen->checkConstConversion(expr, gen->returnTypes[func], scope, "return");
+
+	if (auto call = dynamic_cast<FunctionCall *>(expr); call && call->mustTail)
 	{
-		elements.push_back(val->codegen(scope, gen));
-	}
+		// A musttail call has to be followed by a ret of exactly its result
+		gen->inTailPosition = true;
 
-	auto type = llvm::ArrayType::get(elements[0]->getType(), elements.size());
-	auto alloc = gen->builder.CreateAlloca(type);
+		if (abi.hasSret())
+			gen->sretDestination = func->getArg(0);
 
-	for (size_t i = 0; i < elements.size(); ++i)
-	{
-		auto ptr = gen->builder.CreateGEP(type, alloc, {gen->builder.getInt32(0), gen->builder.getInt32(i)});
-		gen->builder.CreateStore(elements[i], ptr);
+		auto result = call->codegen(scope, gen);
+
+		if (!result || result->getType()->isVoidTy())
+			return gen->builder.CreateRetVoid();
+
+		return gen->builder.CreateRet(result);
 	}
 
-	return gen->builder.CreateLoad(type, alloc);
-}
+	// The callee writes straight into our own return slot
+	if (abi.hasSret() && gen->returnsIndirectly(expr, abi.ret.type, scope))
+	{
+		gen->sretDestination = func->getArg(0);
+		expr->codegen(scope, gen);
+		return gen->builder.CreateRetVoid();
+	}
 
-unsigned int StructInfo::getFieldIndex(std::string fieldName)
-{
-	int fieldIndex = -1;
+	auto e = gen->codegenAs(expr, scope, abi.ret.type);
 
-	for (unsigned i = 0; i < fieldNames.size(); i++)
+	if (!e)
 	{
-		if (fieldNames[i] == fieldName)
-		{
-			fieldIndex = i;
-			break;
-		}
+		std::cerr << "Invalid expression in return\n";
+		return nullptr;
 	}
 
-	return fieldIndex;
+	return gen->emitReturn(e);
 }
 
-llvm::Value *StructLiteral::codegen(GScope *scope, Generator *gen)
+// Rejects @tail calls that LLVM could not turn into a jump
+static void checkTailCall(FunctionCall *call, bool inTailPosition, llvm::Function *callee, llvm::Function *caller, Generator *gen)
 {
-	StructInfo info = gen->structSymbols[moduleName][name];
-
-	if (!info.type)
+	if (!inTailPosition)
 	{
-		std::cout << "Struct type does not exist!\n";
+		std::cerr << "@tail call to " << call->name << " must be returned directly, as in return @tail " << call->name << "(...)\n";
+		exit(1);
 	}
 
-	llvm::Value *alloc = gen->builder.CreateAlloca(info.type);
+	const FunctionABI &calleeABI = gen->functionABIs[callee];
+	const FunctionABI &callerABI = gen->functionABIs[caller];
 
-	for (size_t i = 0; i < fieldNames.size(); ++i)
-	{
-		unsigned int fieldIndex = info.getFieldIndex(fieldNames[i]);
-		llvm::Value *fieldValue = fieldExprs[i]->codegen(scope, gen);
+	bool matches = callee->getFunctionType() == caller->getFunctionType() && calleeABI.ret.kind == callerABI.ret.kind &&
+				   calleeABI.params.size() == callerABI.params.size();
 
-		llvm::Value *fieldPtr = gen->builder.CreateStructGEP(
-			info.type,
-			alloc,
-			fieldIndex,
-			"structfield." + fieldNames[i]);
+	for (size_t i = 0; matches && i < calleeABI.params.size(); ++i)
+		matches = calleeABI.params[i].kind == callerABI.params[i].kind;
 
-		gen->builder.CreateStore(fieldValue, fieldPtr);
+	if (!matches)
+	{
+		std::cerr << "@tail call to " << call->name << " cannot be guaranteed: its signature does not match " << caller->getName().str() << "\n";
+		exit(1);
 	}
 
-	return gen->builder.CreateLoad(info.type, alloc);
+	// Forwarding byval memory through a musttail call overlaps the outgoing and incoming argument areas
+	for (size_t i = 0; i < calleeABI.params.size(); ++i)
+	{
+		if (calleeABI.params[i].kind == ABIArgInfo::Indirect)
+		{
+			std::cerr << "@tail call to " << call->name << " cannot be guaranteed: argument " << i + 1 << " is passed in memory, pass a pointer instead\n";
+			exit(1);
+		}
+	}
+
+	if (call->params.size() > calleeABI.params.size())
+	{
+		std::cerr << "@tail call to " << call->name << " cannot be guaranteed: it passes variadic arguments\n";
+		exit(1);
+	}
 }
 
-llvm::Value *VariableDecl::codegen(GScope *scope, Generator *gen)
+static bool holdsPointer(llvm::Type *type)
 {
-	auto ty = gen->typeInfo(type);
-	auto val = expr->codegen(scope, gen);
-	auto alloc = gen->builder.CreateAlloca(ty.type(gen->ctx));
+	if (type->isPointerTy())
+		return true;
 
-	gen->builder.CreateStore(val, alloc);
-	scope->variables[varName] = std::pair{alloc, ty};
+	if (auto structType = llvm::dyn_cast<llvm::StructType>(type))
+		return std::any_of(structType->element_begin(), structType->element_end(), holdsPointer);
 
-	return alloc;
+	if (type->isArrayTy())
+		return holdsPointer(type->getArrayElementType());
+
+	return type->isVectorTy() && holdsPointer(llvm::cast<llvm::VectorType>(type)->getElementType());
 }
 
-llvm::Value *Return::codegen(GScope *scope, Generator *gen)
+// Whether the pointers an @tail argument carries provably do not reach into the caller's frame. Memory is outside the
+// frame when it is global or reached through an incoming pointer, and a pointer read from memory is trusted only when
+// that memory is a constant global or the slot of a parameter, which must still hold the incoming argument. Those slots
+// are collected in forwarded and checked once the whole body is generated
+static bool outsideFrame(ASTNode *arg, GScope *scope, Generator *gen, std::vector<llvm::Value *> &forwarded)
 {
-	auto e = expr->codegen(scope, gen);
+	if (dynamic_cast<StringLiteral *>(arg))
+		return true;
 
-	if (!e)
+	auto unary = dynamic_cast<UnaryExpr *>(arg);
+	bool addressOf = unary && unary->op.type == TOKEN_REFERENCE;
+	ASTNode *place = addressOf ? unary->expr : arg;
+
+	std::string name;
+	std::vector<ASTNode *> indexes;
+
+	if (auto variable = dynamic_cast<Variable *>(place))
+		name = variable->name;
+	else if (auto access = dynamic_cast<VariableAccess *>(place))
+		name = access->varName, indexes = access->indexes;
+	else
+		return false;
+
+	if (!scope->owner(name) || scope->inRegister(name))
+		return false;
+
+	auto var = scope->getVar(name);
+	auto global = llvm::dyn_cast<llvm::GlobalVariable>(var.first);
+	bool isParameter = gen->parameterSlots.count(var.first);
+
+	bool outside = global;									 // the memory of the current place is not in the frame
+	bool stable = (global && global->isConstant()) || isParameter; // its contents cannot point into the frame
+
+	for (auto index : indexes)
 	{
-		std::cout << "Invalid expression in return\n";
-		return nullptr;
+		bool isArray = !var.second.isPointer() && var.second.elementType->isArrayTy();
+		bool isSlice = !var.second.isPointer() && gen->sliceElement(var.second.elementType);
+
+		if (auto field = dynamic_cast<StructField *>(index))
+		{
+			if (isSlice)
+			{
+				var.second = field->fieldName == "len" ? GType{gen->builder.getInt64Ty(), 0} : GType{gen->sliceElement(var.second.elementType), 1};
+				continue;
+			}
+
+			auto structType = llvm::dyn_cast<llvm::StructType>(var.second.elementType);
+
+			if (var.second.isPointer() || !structType)
+				return false;
+
+			var.second = GType{structType->getElementType(gen->structInfo(structType).getFieldIndex(field->fieldName)), 0};
+			continue;
+		}
+
+		// Elements of an array, and sub-slices of one, stay in its memory, anything else is reached through a pointer
+		if (dynamic_cast<SliceRange *>(index))
+		{
+			if (!isArray)
+				outside = stable;
+
+			return outside;
+		}
+
+		if (isArray)
+		{
+			var.second = GType{var.second.elementType->getArrayElementType(), 0};
+			continue;
+		}
+
+		if (isSlice)
+			var.second = GType{gen->sliceElement(var.second.elementType), 0};
+		else if (var.second.isPointer())
+			var.second = GType{var.second.elementType, var.second.depth - 1};
+		else
+			return false;
+
+		outside = stable;
+		stable = false;
 	}
 
-	return gen->builder.CreateRet(e);
+	if (isParameter && (addressOf ? outside : stable))
+		forwarded.push_back(var.first);
+
+	return addressOf ? outside : stable;
 }
 
 llvm::Value *FunctionCall::codegen(GScope *scope, Generator *gen)
 {
-	if (!gen->functionSymbols.count(moduleName))
+	if (!gen->functionSymbols.count(moduleName) && !gen->genericFunctions.count(moduleName))
 	{
 		std::cerr << "module does not exist: " << moduleName << "\n";
 		exit(1);
 	}
 
-	if (!gen->functionSymbols[moduleName].count(name))
+	// gen->displayFunctionSymbols();
+	llvm::Function *func = gen->callee(this, scope);
+
+	if (!func)
 	{
 		std::cerr << "function does not exist: " << name << "\n";
 		exit(1);
 	}
 
-	// gen->displayFunctionSymbols();
-	llvm::Function *func = gen->functionSymbols[moduleName][name];
+	const FunctionABI &abi = gen->functionABIs[func];
 	std::vector<llvm::Value *> callArgs;
 
-	for (auto arg : params)
+	// Taken before the arguments are generated, since they may contain calls of their own
+	llvm::Value *destination = gen->sretDestination;
+	bool inTailPosition = gen->inTailPosition;
+	gen->sretDestination = nullptr;
+	gen->inTailPosition = false;
+
+	llvm::Function *caller = gen->builder.GetInsertBlock()->getParent();
+
+	if (mustTail)
+	{
+		checkTailCall(this, inTailPosition, func, caller, gen);
+
+		// The callee reuses our frame, so nothing it receives may point into it
+		for (size_t i = 0; i < params.size(); ++i)
+		{
+			std::vector<llvm::Value *> forwarded;
+
+			if (holdsPointer(gen->expressionType(params[i], scope).type(gen->ctx)) && !outsideFrame(params[i], scope, gen, forwarded))
+			{
+				std::cerr << "@tail call to " << name << " cannot be guaranteed: argument " << i + 1 << " may point into the stack frame of "
+						  << caller->getName().str() << ", only parameters, globals and memory reached through them can be passed\n";
+				exit(1);
+			}
+
+			for (auto slot : forwarded)
+				gen->forwardedParameters.push_back({name, slot});
+		}
+	}
+
+	if (abi.hasSret())
+		callArgs.push_back(destination ? destination : gen->createEntryAlloca(abi.ret.type, "sret"));
+
+	for (size_t i = 0; i < params.size(); ++i)
+	{
+		if (i >= abi.params.size())
+		{
+			callArgs.push_back(params[i]->codegen(scope, gen));
+			continue;
+		}
+
+		const ABIArgInfo &info = abi.params[i];
+		GType argType = gen->expressionType(params[i], scope);
+
+		// Only ^const parameters are readonly, see declareFunction
+		GType paramType = argType;
+		paramType.isReadOnly = info.kind == ABIArgInfo::Direct && func->hasParamAttribute(info.firstArg, llvm::Attribute::ReadOnly);
+		gen->checkConstConversion(params[i], paramType, scope, "argument " + std::to_string(i + 1) + " of " + name);
+
+		if (info.kind == ABIArgInfo::Indirect && !argType.isPointer() && argType.elementType == info.type &&
+			(dynamic_cast<Variable *>(params[i]) || dynamic_cast<VariableAccess *>(params[i])))
+		{
+			// byval copies at the call, so a named value can be passed by its address without a temporary
+			gen->inReferenceContext = true;
+			callArgs.push_back(params[i]->codegen(scope, gen));
+			gen->inReferenceContext = false;
+			continue;
+		}
+
+		auto value = gen->codegenAs(params[i], scope, info.type);
+
+		if (info.kind == ABIArgInfo::Indirect)
+		{
+			auto temporary = gen->createEntryAlloca(info.type);
+			gen->builder.CreateStore(value, temporary);
+			callArgs.push_back(temporary);
+		}
+		else if (info.kind == ABIArgInfo::Coerce)
+		{
+			auto temporary = gen->createOverlayAlloca(info.type, info.coercedType(gen->ctx));
+			gen->storeForCoercion(value, temporary);
+
+			for (auto piece : gen->loadPieces(temporary, info))
+				callArgs.push_back(piece);
+		}
+		else
+		{
+			callArgs.push_back(value);
+		}
+	}
+
+	auto call = gen->builder.CreateCall(func, callArgs);
+	abi.addAttributes(call, gen->ctx);
+
+	// Bodies of other modules only arrive with ThinLTO importing, after flatten ran, the inliner takes them from here
+	if (gen->flattened.count(caller))
+		call->addFnAttr(llvm::Attribute::AlwaysInline);
+
+	if (mustTail)
+	{
+		// Temporaries made for the arguments themselves
+		for (auto arg : callArgs)
+		{
+			if (arg->getType()->isPointerTy() && llvm::isa<llvm::AllocaInst>(llvm::getUnderlyingObject(arg)))
+			{
+				std::cerr << "@tail call to " << name << " cannot be guaranteed: an argument points into the stack frame of " << caller->getName().str() << "\n";
+				exit(1);
+			}
+		}
+
+		call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+		return destination ? nullptr : call;
+	}
+
+	if (abi.hasSret())
+	{
+		// With an elided copy the caller asked for the result in place and does not use the value
+		if (destination)
+			return nullptr;
+
+		return gen->builder.CreateLoad(abi.ret.type, callArgs[0]);
+	}
+
+	if (abi.ret.kind == ABIArgInfo::Coerce)
 	{
-		callArgs.push_back(arg->codegen(scope, gen));
+		auto temporary = gen->createOverlayAlloca(abi.ret.type, call->getType());
+		gen->builder.CreateStore(call, temporary);
+		return gen->builder.CreateLoad(abi.ret.type, temporary);
 	}
 
-	return gen->builder.CreateCall(func, callArgs);
+	return call;
 }
 
 void Generator::displayFunctionSymbols()
@@ -2,21 +2,33 @@
 #define GENERATOR_H
 
 #include "parser.h"
+#include "abi.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
 #include <map>
+#include <set>
+#include <tuple>
 
 class FileInfo;
 class Parser;
 class Type;
 class ASTNode;
+struct BinaryExpr;
+struct Directive;
+struct FunctionDefinition;
+struct FunctionCall;
+struct StructDefinition;
+struct StructLiteral;
 
 struct GType
 {
 	llvm::Type *elementType;
 	size_t depth;
+	bool isSigned = true; // of the integer, or of the integer lanes and elements of a vector, array or slice
+	bool isReadOnly = false; // a ^const pointer, or a value in the memory behind one, which is not written through it
 
 	llvm::Type *type(llvm::LLVMContext &ctx);
 	bool isPointer() const { return depth > 0; }
@@ -26,42 +38,175 @@ struct GScope
 {
 	GScope *parent;
 	std::map<std::string, std::pair<llvm::Value *, GType>> variables;
+	std::set<std::string> immutables; // variables that cannot be assigned, e.g. loop induction variables
+	std::map<std::string, std::pair<int64_t, int64_t>> ranges; // inclusive value range of immutable integers
+	std::vector<llvm::AllocaInst *> lifetimes; // stack slots that die when the scope ends
+	std::set<std::string> registers; // immutable locals bound to their value instead of a stack slot, -O0 only
 	
 	GScope(GScope *parent);
 
 	std::pair<llvm::Value *, GType> getVar(std::string name);
+	GScope *owner(std::string name);
+	bool isImmutable(std::string name);
+	bool inRegister(std::string name);
 };
 
 struct StructInfo
 {
 	llvm::StructType *type;
 	std::vector<std::string> fieldNames;
+	std::vector<bool> fieldSigned;
 
 	unsigned int getFieldIndex(std::string fieldName);
 };
 
+struct EnumInfo
+{
+	GType type; // the backing integer
+	std::map<std::string, int64_t> values;
+};
+
+struct CompileOptions
+{
+	unsigned optLevel = 0;
+	bool boundsCheck = false;
+	bool wrapv = false; // -fwrapv, integer overflow wraps instead of being undefined
+	bool thinLTO = false;
+	bool splitModules = false; // -fsplit-modules, one object per jolt module without LTO
+	unsigned partitionSize = 0; // -fpartition-size, functions per streamed partition, 0 keeps the program in one module
+	bool profileGenerate = false;
+	std::string profileUse;		// .profdata file from llvm-profdata merge
+	std::string profileRuntime; // libclang_rt.profile archive, searched for when empty
+	std::string output;			// -o, the executable or the single emitted artifact
+	std::set<std::string> emit = {"link"}; // any of link, obj, asm, llvm-ir and bc
+	bool verbose = false;					// --verbose, the compiler path, tokens and syntax tree go to stderr
+};
+
 class Generator
 {
 public:
-	Generator(Parser *parser);
-	void generate();
+	Generator(Parser *parser, CompileOptions options);
+	int generate();
+	int run(const std::vector<std::string> &args);
 
-	llvm::LLVMContext ctx;
+	std::unique_ptr<llvm::LLVMContext> context; // owned apart from the module so both can be handed to the JIT
+	llvm::LLVMContext &ctx;
 	llvm::IRBuilder<> builder;
-	llvm::Module module;
+	std::unique_ptr<llvm::Module> module;
 	FileInfo *currentFile;
 
 	void displayFunctionSymbols();
 	std::map<std::string, std::map<std::string, llvm::Function *>> functionSymbols;
+	std::map<llvm::Function *, FunctionABI> functionABIs;
+	std::map<llvm::Function *, GType> returnTypes; // the source return type, keeping the signedness LLVM drops
 	std::map<std::string, std::map<std::string, StructInfo>> structSymbols;
+	std::map<std::string, std::map<std::string, EnumInfo>> enumSymbols;
+	EnumInfo *enumInfo(ASTNode *expr, GScope *scope);
+	llvm::ConstantInt *enumValue(ASTNode *expr, GScope *scope);
+	StructInfo &structInfo(llvm::StructType *structType);
+
+	std::map<std::string, std::map<std::string, FunctionDefinition *>> genericFunctions;
+	std::map<std::string, std::map<std::string, StructDefinition *>> genericStructs;
+	std::map<llvm::StructType *, std::pair<StructDefinition *, std::vector<GType>>> structInstances; // the generic and type arguments of each instance
+	std::map<std::string, GType> typeBindings; // "module:T" to its type argument, while an instance is being generated
+	unsigned instanceDepth = 0;				   // how many instances led to the one being generated, bounded by maxInstanceDepth
+	static const unsigned maxInstanceDepth = 64;
+	void enterInstance(const std::string &name);
+	llvm::Type *literalTarget = nullptr;	   // the struct the next struct literal is stored as, it fills in left out type arguments
+	llvm::Function *callee(FunctionCall *call, GScope *scope);
+	llvm::StructType *instantiateStruct(StructDefinition *def, const std::vector<GType> &args);
+	StructInfo &literalInfo(StructLiteral *literal, GScope *scope, llvm::Type *target = nullptr);
+	std::vector<GType> typeArguments(const std::string &module, const std::string &name, const std::vector<std::string> &params,
+									 const std::vector<Type *> &explicitArgs, const std::vector<std::pair<Type *, ASTNode *>> &values, GScope *scope);
+	std::string instanceName(const std::string &name, const std::vector<GType> &args);
+	std::string typeName(GType type);
+	llvm::StructType *sliceType(llvm::Type *element);
+	llvm::Type *sliceElement(llvm::Type *type);
+	llvm::StructType *tupleType(const std::vector<GType> &elements);
+	std::map<llvm::StructType *, std::vector<GType>> tupleElements; // the element types of each tuple, with their signedness
 	GType typeInfo(Type *type);
 	GType expressionType(ASTNode *node, GScope *scope);
+	llvm::Value *convert(llvm::Value *value, llvm::Type *target, bool isSigned = true);
+	llvm::Value *coerce(llvm::Value *value, llvm::Type *target, bool isSigned = true);
+	GType operandType(BinaryExpr *binary, GScope *scope);
+	llvm::Value *codegenAs(ASTNode *expr, GScope *scope, llvm::Type *target);
+	llvm::Constant *constantInitializer(ASTNode *expr, GType type, GScope *scope);
+
+	llvm::AllocaInst *createEntryAlloca(llvm::Type *type, const std::string &name = "");
+	llvm::AllocaInst *createScopedAlloca(llvm::Type *type, GScope *scope, const std::string &name = "");
+	void endLifetimes(GScope *scope);
+	llvm::AllocaInst *spill(const std::string &name, GScope *scope);
+	llvm::MDNode *branchWeights(ASTNode *condition);
+	void boundsCheck(ASTNode *indexExpr, llvm::Value *index, llvm::Value *length, GScope *scope);
+	void trapUnless(llvm::Value *condition);
+
+	llvm::AllocaInst *createOverlayAlloca(llvm::Type *type, llvm::Type *overlay);
+	void storePieces(llvm::Value *ptr, const ABIArgInfo &info, std::vector<llvm::Value *> pieces);
+	void storeForCoercion(llvm::Value *value, llvm::Value *ptr);
+	std::vector<llvm::Value *> loadPieces(llvm::Value *ptr, const ABIArgInfo &info);
+	llvm::Value *emitReturn(llvm::Value *value);
+	bool returnsIndirectly(ASTNode *expr, llvm::Type *type, GScope *scope);
+	void checkConstConversion(ASTNode *expr, GType target, GScope *scope, const std::string &context);
+
+	// A module level variable, kept for instances of generics that are generated into another LLVM module
+	struct ModuleGlobal
+	{
+		std::string name;
+		GType type;
+		bool isConstant;
+		llvm::Constant *value;			  // the initializer when users may fold it, a declaration carries it along
+		llvm::GlobalVariable *definition; // exported on first use, nullptr once -fpartition-size exported it already
+	};
+
+	std::map<std::string, std::vector<ModuleGlobal>> moduleGlobals;
+	bool separateModules() const { return options.thinLTO || options.splitModules || options.partitionSize; }
+	GScope *importGlobals(const std::string &moduleName);
 
 	bool inReferenceContext = false;
+	llvm::Value *sretDestination = nullptr; // where the next indirectly returning call writes its result
+	bool inTailPosition = false;			// the next call is the operand of a return
+	std::map<llvm::Value *, std::string> parameterSlots;						 // the parameters of the function being generated
+	std::vector<std::pair<std::string, llvm::Value *>> forwardedParameters; // parameters passed on by @tail calls, and their callee
+	CompileOptions options;
+	std::set<llvm::Function *> flattened;
 
 private:
 	Parser *parser;
-	void generateDefinitions();
+	bool sysvABI = false;
+	std::unique_ptr<llvm::TargetMachine> targetMachine;
+	std::vector<std::unique_ptr<llvm::Module>> unitModules; // one per jolt module under -flto=thin and -fsplit-modules
+	std::map<llvm::Function *, llvm::BasicBlock *> trapBlocks;
+	std::map<llvm::Type *, llvm::StructType *> sliceTypes; // slices are {ptr, i64}, one named type per element type
+	std::map<llvm::StructType *, llvm::Type *> sliceElements;
+	std::map<std::vector<std::tuple<llvm::Type *, size_t, bool>>, llvm::StructType *> tupleTypes; // tuples are plain structs, one named type per element list
+	void codegen();
+	void generateStructs();
+	void declareFunctions();
+	llvm::Function *declareFunction(FunctionDefinition *func, const std::string &name);
+	void generateInstances();
+
+	struct Instance
+	{
+		FunctionDefinition *definition;
+		std::map<std::string, GType> bindings;
+		llvm::Function *function;
+		unsigned depth;
+	};
+
+	std::vector<Instance> pendingInstances;		  // instances of generic functions declared by a call, their bodies come later
+	std::map<std::string, GScope *> moduleScopes; // the module level variables of each jolt module
+	void applyAttributes(llvm::Function *function, std::vector<Directive> &attributes);
+	void optimize(llvm::Module &target);
+	std::vector<std::string> thinLink();
+	std::vector<std::string> compileUnits();
+	void flushPartition(GScope *fileScope);
+	std::vector<std::string> partitionObjects;
+	unsigned partitionFunctions = 0; // bodies generated into the current partition
+	void importInlineCandidates(llvm::Module &unit);
+	bool emits(const std::string &artifact);
+	std::string artifactPath(const std::string &extension);
+	llvm::SmallVector<char, 0> emitMachineCode(llvm::Module &target, llvm::CodeGenFileType fileType);
+	bool link(const std::vector<std::string> &objects);
 };
 
 #endif
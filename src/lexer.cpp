@@ -94,6 +94,7 @@ std::unordered_map<std::string, TokenType> Lexer::keywords =
         {"return", TOKEN_KEYWORD_RETURN},
         {"for", TOKEN_KEYWORD_FOR},
         {"while", TOKEN_KEYWORD_WHILE},
+        {"in", TOKEN_KEYWORD_IN},
         {"let", TOKEN_KEYWORD_LET},
         {"if", TOKEN_KEYWORD_IF},
         {"else", TOKEN_KEYWORD_ELSE},
@@ -104,12 +105,17 @@ std::unordered_map<std::string, TokenType> Lexer::keywords =
         {"extern", TOKEN_KEYWORD_EXTERN},
         {"import", TOKEN_KEYWORD_IMPORT},
         {"module", TOKEN_KEYWORD_MODULE},
+        {"const", TOKEN_KEYWORD_CONST},
+        {"mut", TOKEN_KEYWORD_MUT},
+        {"enum", TOKEN_KEYWORD_ENUM},
+        {"match", TOKEN_KEYWORD_MATCH},
         {"and", TOKEN_OPERATOR_AND}};
 
 std::unordered_map<TokenType, std::string> Lexer::tokenEnumToString = {
     {TOKEN_KEYWORD_RETURN, "TOKEN_KEYWORD_RETURN"},
     {TOKEN_KEYWORD_FOR, "TOKEN_KEYWORD_FOR"},
     {TOKEN_KEYWORD_WHILE, "TOKEN_KEYWORD_WHILE"},
+    {TOKEN_KEYWORD_IN, "TOKEN_KEYWORD_IN"},
     {TOKEN_KEYWORD_LET, "TOKEN_KEYWORD_LET"},
     {TOKEN_KEYWORD_IF, "TOKEN_KEYWORD_IF"},
     {TOKEN_KEYWORD_ELSE, "TOKEN_KEYWORD_ELSE"},
@@ -120,6 +126,10 @@ std::unordered_map<TokenType, std::string> Lexer::tokenEnumToString = {
     {TOKEN_KEYWORD_EXTERN, "TOKEN_KEYWORD_EXTERN"},
     {TOKEN_KEYWORD_IMPORT, "TOKEN_KEYWORD_IMPORT"},
     {TOKEN_KEYWORD_MODULE, "TOKEN_KEYWORD_MODULE"},
+    {TOKEN_KEYWORD_CONST, "TOKEN_KEYWORD_CONST"},
+    {TOKEN_KEYWORD_MUT, "TOKEN_KEYWORD_MUT"},
+    {TOKEN_KEYWORD_ENUM, "TOKEN_KEYWORD_ENUM"},
+    {TOKEN_KEYWORD_MATCH, "TOKEN_KEYWORD_MATCH"},
     {TOKEN_OPERATOR_PLUS, "TOKEN_OPERATOR_PLUS"},
     {TOKEN_OPERATOR_MINUS, "TOKEN_OPERATOR_MINUS"},
     {TOKEN_OPERATOR_MUL, "TOKEN_OPERATOR_MUL"},
@@ -135,6 +145,12 @@ std::unordered_map<TokenType, std::string> Lexer::tokenEnumToString = {
     {TOKEN_OPERATOR_OR, "TOKEN_OPERATOR_OR"},
     {TOKEN_OPERATOR_NOT, "TOKEN_OPERATOR_NOT"},
     {TOKEN_OPERATOR_ASSIGN, "TOKEN_OPERATOR_ASSIGN"},
+    {TOKEN_OPERATOR_BIT_AND, "TOKEN_OPERATOR_BIT_AND"},
+    {TOKEN_OPERATOR_BIT_OR, "TOKEN_OPERATOR_BIT_OR"},
+    {TOKEN_OPERATOR_BIT_XOR, "TOKEN_OPERATOR_BIT_XOR"},
+    {TOKEN_OPERATOR_BIT_NOT, "TOKEN_OPERATOR_BIT_NOT"},
+    {TOKEN_OPERATOR_SHL, "TOKEN_OPERATOR_SHL"},
+    {TOKEN_OPERATOR_SHR, "TOKEN_OPERATOR_SHR"},
     {TOKEN_INT_LITERAL, "TOKEN_INT_LITERAL"},
     {TOKEN_STRING_LITERAL, "TOKEN_STRING_LITERAL"},
     {TOKEN_BOOL_LITERAL, "TOKEN_BOOL_LITERAL"},
@@ -153,23 +169,25 @@ std::unordered_map<TokenType, std::string> Lexer::tokenEnumToString = {
     {TOKEN_REFERENCE, "TOKEN_REFERENCE"},
     {TOKEN_AT, "TOKEN_AT"},
     {TOKEN_DOT, "TOKEN_DOT"},
+    {TOKEN_RANGE, "TOKEN_RANGE"},
     {TOKEN_COLON, "TOKEN_COLON"},
     {TOKEN_ARROW, "TOKEN_ARROW"},
+    {TOKEN_FAT_ARROW, "TOKEN_FAT_ARROW"},
     {TOKEN_EOF, "TOKEN_EOF"},
     {TOKEN_UNKNOWN, "TOKEN_UNKNOWN"}};
 
 void Lexer::display(std::vector<Token> tokens)
 {
-    std::cout << "Tokens for file: " << input.filename << std::endl;
+    std::cerr << "Tokens for file: " << input.filename << std::endl;
 
     for (size_t i = 0; i < tokens.size(); ++i)
     {
         Token token = tokens[i];
-        std::cout << "Token: " << tokenEnumToString[token.type] << " Value: " << token.value
+        std::cerr << "Token: " << tokenEnumToString[token.type] << " Value: " << token.value
                   << " Position: Row: " << token.position.row << " Column: " << token.position.col << std::endl;
     }
 
-    std::cout << std::endl;
+    std::cerr << std::endl;
 
     input.position = 0;
     input.positionInFile = {1, 0};
@@ -203,7 +221,7 @@ Token Lexer::next()
 
         char currentChar = input.current();
 
-        if (std::isalpha(currentChar))
+        if (std::isalpha(currentChar) || currentChar == '_')
         {
             return parseIdentOrKeyword();
         }
@@ -261,6 +279,12 @@ Token Lexer::next()
                 return {TOKEN_OPERATOR_EQUAL, "==", position};
             }
 
+            if (input.current() == '>')
+            {
+                input.advance();
+                return {TOKEN_FAT_ARROW, "=>", position};
+            }
+
             return {TOKEN_OPERATOR_ASSIGN, "=", position};
         case '<':
 
@@ -272,6 +296,12 @@ Token Lexer::next()
                 return {TOKEN_OPERATOR_LESS_EQUAL, "<=", position};
             }
 
+            if (input.current() == '<')
+            {
+                input.advance();
+                return {TOKEN_OPERATOR_SHL, "<<", position};
+            }
+
             return {TOKEN_OPERATOR_LESS, "<", position};
         case '>':
             input.advance();
@@ -282,9 +312,20 @@ Token Lexer::next()
                 return {TOKEN_OPERATOR_GREATER_EQUAL, ">=", position};
             }
 
+            if (input.current() == '>')
+            {
+                input.advance();
+                return {TOKEN_OPERATOR_SHR, ">>", position};
+            }
+
             return {TOKEN_OPERATOR_GREATER, ">", position};
         case '&':
             input.advance();
+            if (input.current() == '&')
+            {
+                input.advance();
+                return {TOKEN_OPERATOR_AND, "&&", position};
+            }
             return {TOKEN_REFERENCE, "&", position};
         case '|':
             input.advance();
@@ -293,7 +334,10 @@ Token Lexer::next()
                 input.advance();
                 return {TOKEN_OPERATOR_OR, "||", position};
             }
-            return {TOKEN_UNKNOWN, "|", position};
+            return {TOKEN_OPERATOR_BIT_OR, "|", position};
+        case '~':
+            input.advance();
+            return {TOKEN_OPERATOR_BIT_NOT, "~", position};
         case '!':
             input.advance();
             if (input.current() == '=')
@@ -337,6 +381,11 @@ Token Lexer::next()
             return {TOKEN_COMMA, ",", position};
         case '.':
             input.advance();
+            if (input.current() == '.')
+            {
+                input.advance();
+                return {TOKEN_RANGE, "..", position};
+            }
             return {TOKEN_DOT, ".", position};
         case '#':
             input.advance();
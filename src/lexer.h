@@ -13,6 +13,7 @@ enum TokenType
     TOKEN_KEYWORD_EXTERN,
     TOKEN_KEYWORD_FOR,
     TOKEN_KEYWORD_WHILE,
+    TOKEN_KEYWORD_IN,
     TOKEN_KEYWORD_LET,
     TOKEN_KEYWORD_IF,
     TOKEN_KEYWORD_ELSE,
@@ -23,6 +24,10 @@ enum TokenType
     TOKEN_KEYWORD_STRUCT,
     TOKEN_KEYWORD_IMPORT,
     TOKEN_KEYWORD_MODULE,
+    TOKEN_KEYWORD_CONST,
+    TOKEN_KEYWORD_MUT,
+    TOKEN_KEYWORD_ENUM,
+    TOKEN_KEYWORD_MATCH,
  
     // Arithmetic
     TOKEN_OPERATOR_PLUS,
@@ -43,6 +48,14 @@ enum TokenType
     TOKEN_OPERATOR_NOT,
     TOKEN_OPERATOR_ASSIGN,
 
+    // Bitwise, a binary & and ^ are lexed as TOKEN_REFERENCE and TOKEN_POINTER and retyped by the parser
+    TOKEN_OPERATOR_BIT_AND,
+    TOKEN_OPERATOR_BIT_OR,
+    TOKEN_OPERATOR_BIT_XOR,
+    TOKEN_OPERATOR_BIT_NOT,
+    TOKEN_OPERATOR_SHL,
+    TOKEN_OPERATOR_SHR,
+
     // Literals
     TOKEN_INT_LITERAL,
     TOKEN_STRING_LITERAL,
@@ -66,8 +79,10 @@ enum TokenType
     TOKEN_POINTER,
 		TOKEN_REFERENCE,
     TOKEN_DOT,
+    TOKEN_RANGE,
     TOKEN_COLON,
     TOKEN_ARROW,
+    TOKEN_FAT_ARROW,
     TOKEN_EOF,
     TOKEN_UNKNOWN
 };
@@ -1,31 +1,174 @@
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 #include "lexer.h"
 #include "parser.h"
 #include "generator.h"
 
-int main(int argc, char** argv) 
+int main(int argc, char** argv)
 {
-	if (argc < 2) 
+	CompileOptions options;
+	char* inputPath = nullptr;
+
+	// compiler run file.jl [args] executes the program in process, everything after the file is passed to it
+	bool runMode = argc > 1 && std::string(argv[1]) == "run";
+	std::vector<std::string> programArgs;
+
+	for (int i = runMode ? 2 : 1; i < argc; i++)
 	{
-			std::cerr << "Usage: " << argv[0] << " <filename>" << std::endl;
+		std::string arg = argv[i];
+
+		if (runMode && inputPath)
+		{
+			programArgs.push_back(arg);
+			continue;
+		}
+
+		if (arg.size() == 3 && arg.rfind("-O", 0) == 0 && arg[2] >= '0' && arg[2] <= '3')
+		{
+			options.optLevel = arg[2] - '0';
+		}
+		else if (arg == "-fbounds-check")
+		{
+			options.boundsCheck = true;
+		}
+		else if (arg == "-fno-bounds-check")
+		{
+			options.boundsCheck = false;
+		}
+		else if (arg == "-fwrapv")
+		{
+			options.wrapv = true;
+		}
+		else if (arg == "-fno-wrapv")
+		{
+			options.wrapv = false;
+		}
+		else if (arg == "-flto=thin")
+		{
+			options.thinLTO = true;
+		}
+		else if (arg == "-fno-lto")
+		{
+			options.thinLTO = false;
+		}
+		else if (arg == "-fsplit-modules")
+		{
+			options.splitModules = true;
+		}
+		else if (arg.rfind("-fpartition-size=", 0) == 0)
+		{
+			std::string size = arg.substr(std::string("-fpartition-size=").size());
+
+			if (size.empty() || size.find_first_not_of("0123456789") != std::string::npos || std::stoul(size) == 0)
+			{
+				std::cerr << "-fpartition-size expects a positive number of functions" << std::endl;
+				exit(1);
+			}
+
+			options.partitionSize = std::stoul(size);
+		}
+		else if (arg == "-fprofile-generate")
+		{
+			options.profileGenerate = true;
+		}
+		else if (arg.rfind("-fprofile-use=", 0) == 0)
+		{
+			options.profileUse = arg.substr(std::string("-fprofile-use=").size());
+
+			if (!std::filesystem::exists(options.profileUse))
+			{
+				std::cerr << "Profile file does not exist: " << options.profileUse << std::endl;
+				exit(1);
+			}
+		}
+		else if (arg.rfind("-fprofile-runtime=", 0) == 0)
+		{
+			options.profileRuntime = arg.substr(std::string("-fprofile-runtime=").size());
+		}
+		else if (arg == "-o" && i + 1 < argc)
+		{
+			options.output = argv[++i];
+		}
+		else if (arg.rfind("--emit=", 0) == 0)
+		{
+			std::stringstream kinds(arg.substr(std::string("--emit=").size()));
+			std::string kind;
+			options.emit.clear();
+
+			while (std::getline(kinds, kind, ','))
+			{
+				if (kind != "link" && kind != "obj" && kind != "asm" && kind != "llvm-ir" && kind != "bc")
+				{
+					std::cerr << "Unknown --emit kind: " << kind << ", expected link, obj, asm, llvm-ir or bc" << std::endl;
+					exit(1);
+				}
+
+				options.emit.insert(kind);
+			}
+		}
+		else if (arg == "--verbose")
+		{
+			options.verbose = true;
+		}
+		else if (arg[0] == '-')
+		{
+			std::cerr << "Unknown option: " << arg << std::endl;
+			exit(1);
+		}
+		else
+		{
+			inputPath = argv[i];
+		}
+	}
+
+	if (options.thinLTO && options.splitModules)
+	{
+		std::cerr << "-flto=thin already compiles every module on its own, -fsplit-modules cannot be added to it" << std::endl;
+		exit(1);
+	}
+
+	if (options.partitionSize && (options.thinLTO || options.splitModules))
+	{
+		std::cerr << "-fpartition-size cannot be combined with -flto=thin or -fsplit-modules" << std::endl;
+		exit(1);
+	}
+
+	if (options.profileGenerate && !options.profileUse.empty())
+	{
+		std::cerr << "-fprofile-generate and -fprofile-use cannot be combined" << std::endl;
+		exit(1);
+	}
+
+	if (!inputPath)
+	{
+			std::cerr << "Usage: " << argv[0] << " [-O0|-O1|-O2|-O3] [-fbounds-check] [-fwrapv] [-flto=thin|-fsplit-modules|-fpartition-size=<n>] [-fprofile-generate|-fprofile-use=<file>]" << std::endl;
+			std::cerr << "       " << std::string(std::strlen(argv[0]), ' ') << " [-o <path>] [--emit=link,obj,asm,llvm-ir,bc] [--verbose] <filename>" << std::endl;
+			std::cerr << "       " << argv[0] << " run [options] <filename> [args]" << std::endl;
 			exit(1);
 	}
 
-	char* inputPath = argv[1];
 	std::filesystem::path filepath(inputPath);
 	std::filesystem::path compilerPath(argv[0]);
 
-	
+
 	if (!compilerPath.is_absolute())
 		compilerPath = std::filesystem::absolute(compilerPath);
- 
-	std::cout << compilerPath << "\n";
 
-	Parser par(filepath, compilerPath);
-	Generator gen(&par);
+	if (options.verbose)
+		std::cerr << compilerPath << "\n";
 
-	gen.generate();
-}
+	Parser par(filepath, compilerPath, options.verbose);
+	Generator gen(&par, options);
 
+	if (runMode)
+	{
+		programArgs.insert(programArgs.begin(), filepath.string());
+		return gen.run(programArgs);
+	}
 
+	return gen.generate();
+}
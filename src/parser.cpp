@@ -7,7 +7,7 @@ FileParser::FileParser(std::vector<Token> tokens, std::filesystem::path path, Pa
 	parser->parsedFiles.insert(path);
 }
 
-Parser::Parser(std::filesystem::path p, std::filesystem::path compilerPath) : compilerPath(compilerPath)
+Parser::Parser(std::filesystem::path p, std::filesystem::path compilerPath, bool verbose) : compilerPath(compilerPath), verbose(verbose)
 {
 	if (!p.is_absolute())
 	{
@@ -61,7 +61,9 @@ std::vector<ASTNode *> FileParser::parse()
 		}
 
 		auto node = parseGlobal();
-		node->print(0);
+		if (parser->verbose)
+			node->print(0);
+
 		nodes.push_back(node);
 	}
 
@@ -75,12 +77,34 @@ ASTNode *FileParser::parseGlobal()
 	switch (cur.type)
 	{
 	case TOKEN_IDENTIFIER:
-		if (tokens[index + 3].type == TOKEN_LEFT_PAREN)
+	{
+		// name :: [T] (...) and name :: [T] struct are generic, the parameter list is skipped to find out which
+		auto next = tokens[skipTypeArguments(index + 3)].type;
+
+		if (next == TOKEN_LEFT_PAREN)
 			return parseFunction();
-		else if (tokens[index + 3].type == TOKEN_KEYWORD_STRUCT)
+		else if (next == TOKEN_KEYWORD_STRUCT)
 			return parseStruct();
+		else if (tokens[index + 3].type == TOKEN_KEYWORD_ENUM)
+			return parseEnum();
 		break;
 	}
+	case TOKEN_KEYWORD_CONST:
+	case TOKEN_KEYWORD_LET:
+		return parseGlobalDecl();
+	case TOKEN_HASHTAG:
+	{
+		auto attributes = parseDirectives();
+		checkFunctionAttributes(attributes);
+
+		if (tokens[index].type != TOKEN_IDENTIFIER || tokens[skipTypeArguments(index + 3)].type != TOKEN_LEFT_PAREN)
+			expect(TOKEN_LEFT_PAREN, "Expected function definition after attributes");
+
+		auto def = parseFunction();
+		def->attributes = attributes;
+		return def;
+	}
+	}
 
 	Token p = tokens[index];
 	FilePosition pos = p.position;
@@ -93,6 +117,99 @@ ASTNode *FileParser::parseGlobal()
 	exit(1);
 }
 
+GlobalDecl *FileParser::parseGlobalDecl()
+{
+	// Only let mut declares a mutable global, const and a plain let are both read only
+	bool isConstant = tokens[index++].type == TOKEN_KEYWORD_CONST || tokens[index].type != TOKEN_KEYWORD_MUT;
+	index += tokens[index].type == TOKEN_KEYWORD_MUT;
+
+	auto name = expectConsume(TOKEN_IDENTIFIER, "Expected variable name").value;
+	expectConsume(TOKEN_COLON, "Expect colon for variable type");
+	auto type = parseType();
+	ASTNode *expr = nullptr;
+
+	if (isConstant || tokens[index].type == TOKEN_OPERATOR_ASSIGN)
+	{
+		expectConsume(TOKEN_OPERATOR_ASSIGN, "Expected a value for constant " + name);
+		expr = parseExpression();
+	}
+
+	expectConsume(TOKEN_SEMICOLON, "Expected semicolon");
+
+	return new GlobalDecl(name, type, expr, isConstant);
+}
+
+EnumDefinition *FileParser::parseEnum()
+{
+	auto name = expectConsume(TOKEN_IDENTIFIER, "").value;
+	auto moduleName = parser->pathToModule[path];
+
+	std::vector<std::string> variantNames;
+	std::vector<int64_t> values;
+
+	expectConsume(TOKEN_COLON, "Expected colon after name");
+	expectConsume(TOKEN_COLON, "Expected colon after name");
+	expectConsume(TOKEN_KEYWORD_ENUM, "");
+
+	// The backing type defaults to i32
+	Type *type = tokens[index].type == TOKEN_LEFT_BRACE ? new Type(0, "i32") : parseType();
+
+	expectConsume(TOKEN_LEFT_BRACE, "Expected enum body");
+
+	while (tokens[index].type != TOKEN_RIGHT_BRACE)
+	{
+		Token variant = expectConsume(TOKEN_IDENTIFIER, "Expected variant name");
+		variantNames.push_back(variant.value);
+
+		// A variant without a value follows the previous one, the first one is 0
+		int64_t value = 0;
+		std::string error;
+		Token culprit = variant;
+
+		if (tokens[index].type == TOKEN_OPERATOR_ASSIGN)
+		{
+			index++;
+			bool negative = tokens[index].type == TOKEN_OPERATOR_MINUS;
+			index += negative;
+			culprit = expectConsume(TOKEN_INT_LITERAL, "Expected variant value");
+			uint64_t magnitude;
+
+			// The magnitude of the smallest i64 is one more than the largest
+			if (llvm::StringRef(culprit.value).getAsInteger(10, magnitude) || magnitude > (uint64_t)INT64_MAX + negative)
+				error = "Variant value does not fit in 64 bits";
+			else
+				value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+		}
+		else if (!values.empty() && values.back() == INT64_MAX)
+		{
+			error = "Variant value does not fit in 64 bits, the variant before it has the largest value";
+		}
+		else if (!values.empty())
+		{
+			value = values.back() + 1;
+		}
+
+		if (!error.empty())
+		{
+			std::cerr << path.string() << ":"
+					  << culprit.position.row << ":" << culprit.position.col
+					  << " > error: " << error
+					  << " Received: " << culprit.value
+					  << std::endl;
+			exit(1);
+		}
+
+		values.push_back(value);
+
+		if (tokens[index].type == TOKEN_COMMA)
+			expectConsume(TOKEN_COMMA, "Expected comma after variant");
+	}
+
+	expectConsume(TOKEN_RIGHT_BRACE, "Expected closing enum brace");
+
+	return new EnumDefinition(name, moduleName, type, variantNames, values);
+}
+
 StructDefinition *FileParser::parseStruct()
 {
 	auto name = expectConsume(TOKEN_IDENTIFIER, "").value;
@@ -106,6 +223,7 @@ StructDefinition *FileParser::parseStruct()
 	expectConsume(TOKEN_COLON, "Expected colon after name");
 	expectConsume(TOKEN_COLON, "Expected colon after name");
 
+	auto typeParams = parseTypeParameters();
 	expectConsume(TOKEN_KEYWORD_STRUCT, "");
 
 	expectConsume(TOKEN_LEFT_BRACE, "Expected colon after name");
@@ -122,7 +240,10 @@ StructDefinition *FileParser::parseStruct()
 
 	expectConsume(TOKEN_RIGHT_BRACE, "Expected colon after name");
 
-	return new StructDefinition(name, moduleName, fieldNames, fieldTypes);
+	auto def = new StructDefinition(name, moduleName, fieldNames, fieldTypes);
+	def->typeParams = typeParams;
+
+	return def;
 }
 
 FunctionDefinition *FileParser::parseFunction()
@@ -138,6 +259,8 @@ FunctionDefinition *FileParser::parseFunction()
 	expectConsume(TOKEN_COLON, "Expected Global Definition (::)");
 	expectConsume(TOKEN_COLON, "Expected Global Definition (::)");
 
+	def->typeParams = parseTypeParameters();
+
 	expectConsume(TOKEN_LEFT_PAREN, "Expected opening function paren");
 
 	// Parse arguments
@@ -158,7 +281,10 @@ FunctionDefinition *FileParser::parseFunction()
 
 	expectConsume(TOKEN_RIGHT_PAREN, "Expected closing function paren");
 
-	expect(TOKEN_IDENTIFIER, "Expected return type");
+	// A named type, a tuple (a, b), or a slice []T or array [T; n]
+	if (tokens[index].type != TOKEN_LEFT_PAREN && tokens[index].type != TOKEN_LEFT_SQUARE_BRACKET)
+		expect(TOKEN_IDENTIFIER, "Expected return type");
+
 	def->returnType = parseType();
 
 	if (tokens[index].type == TOKEN_LEFT_BRACE)
@@ -169,6 +295,64 @@ FunctionDefinition *FileParser::parseFunction()
 	return def;
 }
 
+void FileParser::checkFunctionAttributes(std::vector<Directive> &attributes)
+{
+	std::set<std::string> seen;
+
+	for (auto &attribute : attributes)
+	{
+		std::string error;
+
+		if (attribute.name == "optimize")
+		{
+			if (attribute.args.size() != 1 || (attribute.args[0] != "size" && attribute.args[0] != "speed" && attribute.args[0] != "none"))
+				error = "Expected #optimize(size), #optimize(speed) or #optimize(none)";
+		}
+		else if (attribute.name != "inline" && attribute.name != "noinline" && attribute.name != "hot" && attribute.name != "cold" && attribute.name != "flatten")
+		{
+			error = "Unknown function attribute";
+		}
+		else if (!attribute.args.empty())
+		{
+			error = "Function attribute takes no arguments";
+		}
+
+		// optnone cannot be combined with alwaysinline, optsize or minsize, and the inliner never runs on its body. A cold
+		// function is optimized for size, not speed
+		static const std::vector<std::pair<std::string, std::string>> conflicts = {
+			{"inline", "noinline"},
+			{"hot", "cold"},
+			{"inline", "optimize(none)"},
+			{"flatten", "optimize(none)"},
+			{"cold", "optimize(none)"},
+			{"cold", "optimize(speed)"},
+		};
+		std::string key = attribute.name == "optimize" && error.empty() ? "optimize(" + attribute.args[0] + ")" : attribute.name;
+
+		for (auto &[first, second] : conflicts)
+		{
+			if ((key == first && seen.count(second)) || (key == second && seen.count(first)))
+				error = "Conflicting function attribute";
+		}
+
+		if (attribute.name == "optimize" && seen.count("optimize"))
+			error = "Conflicting function attribute";
+
+		seen.insert(attribute.name);
+		seen.insert(key);
+
+		if (!error.empty())
+		{
+			std::cerr << path.string() << ":"
+					  << attribute.position.row << ":" << attribute.position.col
+					  << " > error: " << error
+					  << " Received: #" << attribute.name
+					  << std::endl;
+			exit(1);
+		}
+	}
+}
+
 Type *FileParser::parseType()
 {
 	Type *t = new Type(0, "");
@@ -178,6 +362,72 @@ Type *FileParser::parseType()
 	{
 		t->pointerLevel++;
 		index++;
+
+		// A qualifier belongs to the outermost pointer, the one a parameter attribute can describe
+		if (t->pointerLevel == 1 && tokens[index].type == TOKEN_IDENTIFIER && tokens[index].value == "unique")
+		{
+			t->isUnique = true;
+			index++;
+		}
+		else if (t->pointerLevel == 1 && tokens[index].type == TOKEN_KEYWORD_CONST)
+		{
+			t->isConst = true;
+			index++;
+		}
+	}
+
+	Type *type = parseTypeName(t);
+	type->isUnique = t->isUnique;
+	type->isConst = t->isConst;
+
+	return type;
+}
+
+// The part of a type after its pointer prefix
+Type *FileParser::parseTypeName(Type *t)
+{
+	if (tokens[index].type == TOKEN_IDENTIFIER && tokens[index].value == "vec" && tokens[index + 1].type == TOKEN_LEFT_SQUARE_BRACKET)
+	{
+		index += 2;
+		auto laneType = parseType();
+		expectConsume(TOKEN_SEMICOLON, "Expected semicolon in vector type");
+		auto lanes = std::stoi(expectConsume(TOKEN_INT_LITERAL, "Expected vector lane count").value);
+		expectConsume(TOKEN_RIGHT_SQUARE_BRACKET, "Expected closing bracket");
+
+		return new VectorType(laneType, lanes, t->pointerLevel);
+	}
+
+	if (tokens[index].type == TOKEN_LEFT_SQUARE_BRACKET && tokens[index + 1].type == TOKEN_RIGHT_SQUARE_BRACKET)
+	{
+		index += 2;
+		return new SliceType(parseType(), t->pointerLevel);
+	}
+
+	if (tokens[index].type == TOKEN_LEFT_PAREN)
+	{
+		index++;
+		std::vector<Type *> types = {parseType()};
+
+		while (tokens[index].type == TOKEN_COMMA)
+		{
+			index++;
+			types.push_back(parseType());
+		}
+
+		expectConsume(TOKEN_RIGHT_PAREN, "Expected closing paren in tuple type");
+
+		if (types.size() < 2)
+		{
+			FilePosition pos = tokens[index - 1].position;
+
+			std::cerr << path.string() << ":"
+					  << pos.row << ":" << pos.col
+					  << " > error: " << "A tuple type needs at least two elements"
+					  << std::endl;
+			exit(1);
+		}
+
+		return new TupleType(types, t->pointerLevel);
 	}
 
 	if (tokens[index].type == TOKEN_LEFT_SQUARE_BRACKET)
@@ -198,11 +448,15 @@ Type *FileParser::parseType()
 		index++;
 		auto structName = expectConsume(TOKEN_IDENTIFIER, "Expected type identifier").value;
 
-		return new StructType(name, structName, t->pointerLevel);
+		auto structType = new StructType(name, structName, t->pointerLevel);
+		structType->typeArgs = parseTypeArguments();
+		return structType;
 	}
 	else if (!isBuiltInType(name))
 	{
-		return new StructType(parser->pathToModule[path], name, t->pointerLevel);
+		auto structType = new StructType(parser->pathToModule[path], name, t->pointerLevel);
+		structType->typeArgs = parseTypeArguments();
+		return structType;
 	}
 
 	t->name = name;
@@ -210,6 +464,64 @@ Type *FileParser::parseType()
 	return t;
 }
 
+// [T, U] after the :: of a generic function or struct, empty for any other
+std::vector<std::string> FileParser::parseTypeParameters()
+{
+	std::vector<std::string> params;
+
+	if (tokens[index].type != TOKEN_LEFT_SQUARE_BRACKET)
+		return params;
+
+	do
+	{
+		index++;
+		params.push_back(expectConsume(TOKEN_IDENTIFIER, "Expected type parameter name").value);
+	} while (tokens[index].type == TOKEN_COMMA);
+
+	expectConsume(TOKEN_RIGHT_SQUARE_BRACKET, "Expected closing bracket after type parameters");
+
+	return params;
+}
+
+// [i64, bool] after the name of a generic struct or function, empty when there is none
+std::vector<Type *> FileParser::parseTypeArguments()
+{
+	std::vector<Type *> args;
+
+	if (tokens[index].type != TOKEN_LEFT_SQUARE_BRACKET)
+		return args;
+
+	do
+	{
+		index++;
+		args.push_back(parseType());
+	} while (tokens[index].type == TOKEN_COMMA);
+
+	expectConsume(TOKEN_RIGHT_SQUARE_BRACKET, "Expected closing bracket after type arguments");
+
+	return args;
+}
+
+// The position after a bracketed list starting at `at`, or `at` itself when there is no list. In an expression,
+// name[...] is only a list of type arguments when a call or struct literal follows, otherwise it indexes
+size_t FileParser::skipTypeArguments(size_t at)
+{
+	if (tokens[at].type != TOKEN_LEFT_SQUARE_BRACKET)
+		return at;
+
+	int depth = 0;
+
+	for (size_t i = at; i < tokens.size() && tokens[i].type != TOKEN_EOF; ++i)
+	{
+		if (tokens[i].type == TOKEN_LEFT_SQUARE_BRACKET)
+			depth++;
+		else if (tokens[i].type == TOKEN_RIGHT_SQUARE_BRACKET && --depth == 0)
+			return i + 1;
+	}
+
+	return at;
+}
+
 bool FileParser::isBuiltInType(std::string &t)
 {
 	std::vector<std::string> types = {
@@ -262,12 +574,111 @@ Block *FileParser::parseBlock()
 While *FileParser::parseWhile()
 {
 	expectConsume(TOKEN_KEYWORD_WHILE, "");
+	allowStructLiteral = false;
 	auto condition = parseExpression();
+	allowStructLiteral = true;
 	auto body = parseBlock();
 
 	return new While(condition, body);
 }
 
+For *FileParser::parseFor(std::vector<Directive> hints)
+{
+	for (auto &hint : hints)
+	{
+		std::string error;
+
+		if (hint.name == "unroll" || hint.name == "vectorize")
+		{
+			// The count becomes an i32 in the loop metadata
+			auto isCount = [](const std::string &arg)
+			{
+				return !arg.empty() && arg.size() <= 9 && std::all_of(arg.begin(), arg.end(), ::isdigit) && std::stoi(arg) > 0;
+			};
+
+			if (hint.args.size() > 1 || (hint.args.size() == 1 && !isCount(hint.args[0])))
+				error = "Expected a positive integer count, e.g. #" + hint.name + "(4)";
+		}
+		else if (hint.name == "no_alias")
+		{
+			if (!hint.args.empty())
+				error = "Loop hint takes no arguments";
+		}
+		else
+		{
+			error = "Unknown loop hint";
+		}
+
+		if (!error.empty())
+		{
+			std::cerr << path.string() << ":"
+					  << hint.position.row << ":" << hint.position.col
+					  << " > error: " << error
+					  << " Received: #" << hint.name
+					  << std::endl;
+			exit(1);
+		}
+	}
+
+	expectConsume(TOKEN_KEYWORD_FOR, "Expected keyword for");
+	auto varName = expectConsume(TOKEN_IDENTIFIER, "Expected loop variable name").value;
+	Type *type = nullptr;
+
+	if (tokens[index].type == TOKEN_COLON)
+	{
+		index++;
+		type = parseType();
+	}
+
+	expectConsume(TOKEN_KEYWORD_IN, "Expected keyword in");
+
+	allowStructLiteral = false;
+	auto start = parseExpression();
+	expectConsume(TOKEN_RANGE, "Expected .. in range");
+	auto end = parseExpression();
+	allowStructLiteral = true;
+
+	auto body = parseBlock();
+
+	return new For(varName, type, start, end, body, hints);
+}
+
+std::vector<Directive> FileParser::parseDirectives()
+{
+	std::vector<Directive> directives;
+
+	while (tokens[index].type == TOKEN_HASHTAG)
+	{
+		Directive directive;
+		directive.position = tokens[index].position;
+		index++;
+		directive.name = expectConsume(TOKEN_IDENTIFIER, "Expected directive name").value;
+
+		if (tokens[index].type == TOKEN_LEFT_PAREN)
+		{
+			index++;
+
+			while (tokens[index].type != TOKEN_RIGHT_PAREN)
+			{
+				if (tokens[index].type != TOKEN_INT_LITERAL)
+					expect(TOKEN_IDENTIFIER, "Expected directive argument");
+
+				directive.args.push_back(tokens[index].value);
+				index++;
+
+				if (tokens[index].type != TOKEN_RIGHT_PAREN)
+					expectConsume(TOKEN_COMMA, "Expected comma between directive arguments");
+			}
+
+			expectConsume(TOKEN_RIGHT_PAREN, "Expected closing paren");
+		}
+
+		directives.push_back(directive);
+	}
+
+	return directives;
+}
+
 Conditional *FileParser::parseConditional()
 {
 	std::vector<std::pair<ASTNode *, Block *>> conditions;
@@ -279,7 +690,9 @@ Conditional *FileParser::parseConditional()
 		if (tokens[index].type == TOKEN_KEYWORD_IF)
 		{
 			index++;
+			allowStructLiteral = false;
 			cond = parseExpression();
+			allowStructLiteral = true;
 		}
 
 		auto block = parseBlock();
@@ -292,6 +705,69 @@ Conditional *FileParser::parseConditional()
 	return new Conditional(conditions);
 }
 
+Match *FileParser::parseMatch()
+{
+	expectConsume(TOKEN_KEYWORD_MATCH, "");
+
+	allowStructLiteral = false;
+	auto value = parseExpression();
+	allowStructLiteral = true;
+
+	std::vector<std::pair<std::vector<ASTNode *>, Block *>> arms;
+
+	expectConsume(TOKEN_LEFT_BRACE, "Expected match body");
+
+	while (tokens[index].type != TOKEN_RIGHT_BRACE)
+	{
+		std::vector<ASTNode *> patterns;
+
+		if (tokens[index].type == TOKEN_KEYWORD_ELSE)
+		{
+			index++;
+		}
+		else
+		{
+			patterns.push_back(parseExpression());
+
+			while (tokens[index].type == TOKEN_COMMA)
+			{
+				index++;
+				patterns.push_back(parseExpression());
+			}
+		}
+
+		expectConsume(TOKEN_FAT_ARROW, "Expected => after match pattern");
+		arms.push_back({patterns, parseBlock()});
+	}
+
+	expectConsume(TOKEN_RIGHT_BRACE, "Expected closing match brace");
+
+	return new Match(value, arms);
+}
+
+Destructure *FileParser::parseDestructure()
+{
+	expectConsume(TOKEN_KEYWORD_LET, "");
+	bool isMutable = tokens[index].type == TOKEN_KEYWORD_MUT;
+	index += isMutable;
+
+	expectConsume(TOKEN_LEFT_PAREN, "Expected ( before the destructured names");
+	std::vector<std::string> names = {expectConsume(TOKEN_IDENTIFIER, "Expected variable name").value};
+
+	while (tokens[index].type == TOKEN_COMMA)
+	{
+		index++;
+		names.push_back(expectConsume(TOKEN_IDENTIFIER, "Expected variable name").value);
+	}
+
+	expectConsume(TOKEN_RIGHT_PAREN, "Expected ) after the destructured names");
+	expectConsume(TOKEN_OPERATOR_ASSIGN, "Expect assign eq");
+	auto expr = parseExpression();
+	expectConsume(TOKEN_SEMICOLON, "Expected semicolon");
+
+	return new Destructure(names, expr, isMutable);
+}
+
 ASTNode *FileParser::parseLocal()
 {
 	switch (tokens[index].type)
@@ -302,7 +778,8 @@ ASTNode *FileParser::parseLocal()
 	}
 	case TOKEN_IDENTIFIER:
 	{
-		if (tokens[index + 1].type == TOKEN_LEFT_PAREN)
+		// f(...) or f[T](...), where the brackets hold type arguments rather than an index
+		if (tokens[skipTypeArguments(index + 1)].type == TOKEN_LEFT_PAREN)
 		{
 			auto f = parseFunctionCall(parser->pathToModule[path]);
 			expectConsume(TOKEN_SEMICOLON, "Expected semicolon");
@@ -322,6 +799,22 @@ ASTNode *FileParser::parseLocal()
 			return f;
 		}
 	}
+	case TOKEN_AT:
+	{
+		// @asm has no value, it is only parsed as a statement of its own
+		if (tokens[index].type == TOKEN_AT && tokens[index + 1].value == "asm")
+		{
+			index += 2;
+			expectConsume(TOKEN_LEFT_PAREN, "Expected opening paren");
+			auto statement = parseAsm();
+			expectConsume(TOKEN_SEMICOLON, "Expected semicolon");
+			return statement;
+		}
+
+		auto expr = parseExpression();
+		expectConsume(TOKEN_SEMICOLON, "Expected semicolon");
+		return expr;
+	}
 	case TOKEN_KEYWORD_RETURN:
 	{
 		Return *ret = new Return;
@@ -332,13 +825,30 @@ ASTNode *FileParser::parseLocal()
 		return ret;
 	}
 	case TOKEN_KEYWORD_LET:
+	{
+		size_t next = index + 1 + (tokens[index + 1].type == TOKEN_KEYWORD_MUT);
+
+		if (tokens[next].type == TOKEN_LEFT_PAREN)
+			return parseDestructure();
+
 		return parseVariableDecl();
+	}
 	case TOKEN_LEFT_BRACE:
 		return parseBlock();
 	case TOKEN_KEYWORD_IF:
 		return parseConditional();
+	case TOKEN_KEYWORD_MATCH:
+		return parseMatch();
 	case TOKEN_KEYWORD_WHILE:
 		return parseWhile();
+	case TOKEN_KEYWORD_FOR:
+		return parseFor({});
+	case TOKEN_HASHTAG:
+	{
+		auto hints = parseDirectives();
+		expect(TOKEN_KEYWORD_FOR, "Expected for loop after loop hints");
+		return parseFor(hints);
+	}
 	}
 
 	Token p = tokens[index];
@@ -358,6 +868,7 @@ FunctionCall *FileParser::parseFunctionCall(std::string &module)
 
 	call->moduleName = module;
 	call->name = expectConsume(TOKEN_IDENTIFIER, "Provide an identifier for the function call").value;
+	call->typeArgs = parseTypeArguments();
 
 	expectConsume(TOKEN_LEFT_PAREN, "Expected opening function paren");
 
@@ -381,19 +892,18 @@ FunctionCall *FileParser::parseFunctionCall(std::string &module)
 VariableDecl *FileParser::parseVariableDecl()
 {
 	expectConsume(TOKEN_KEYWORD_LET, "");
+	bool isMutable = tokens[index].type == TOKEN_KEYWORD_MUT;
+	index += isMutable;
+
 	auto name = expectConsume(TOKEN_IDENTIFIER, "Expected variable name").value;
 	expectConsume(TOKEN_COLON, "Expect colon for variable type");
 	auto type = parseType();
 	expectConsume(TOKEN_OPERATOR_ASSIGN, "Expect assign eq");
 
-	if (dynamic_cast<ArrayType *>(type))
-	{
-		std::cout << "AAAAAAAAAAAAAAAAAAA\n";
-	}
 	auto expr = parseExpression();
 	expectConsume(TOKEN_SEMICOLON, "Expected semicolon");
 
-	return new VariableDecl(name, type, expr);
+	return new VariableDecl(name, type, expr, isMutable);
 }
 
 int getPrecedence(TokenType type)
@@ -403,9 +913,19 @@ int getPrecedence(TokenType type)
 	case TOKEN_OPERATOR_MUL:
 	case TOKEN_OPERATOR_DIV:
 	case TOKEN_OPERATOR_MOD:
-		return 5;
+		return 9;
 	case TOKEN_OPERATOR_PLUS:
 	case TOKEN_OPERATOR_MINUS:
+		return 8;
+	case TOKEN_OPERATOR_SHL:
+	case TOKEN_OPERATOR_SHR:
+		return 7;
+	// Bitwise operators bind tighter than comparisons, so flags & MASK == 0 tests the masked bits
+	case TOKEN_OPERATOR_BIT_AND:
+		return 6;
+	case TOKEN_OPERATOR_BIT_XOR:
+		return 5;
+	case TOKEN_OPERATOR_BIT_OR:
 		return 4;
 	case TOKEN_OPERATOR_LESS:
 	case TOKEN_OPERATOR_GREATER:
@@ -431,6 +951,13 @@ ASTNode *FileParser::parseExpression(int precedence)
 	for (;;)
 	{
 		Token tok = tokens[index];
+
+		// After an operand, & and ^ can only be the binary bitwise and and xor
+		if (tok.type == TOKEN_REFERENCE)
+			tok.type = TOKEN_OPERATOR_BIT_AND;
+		else if (tok.type == TOKEN_POINTER)
+			tok.type = TOKEN_OPERATOR_BIT_XOR;
+
 		int currentPrecedence = getPrecedence(tok.type);
 
 		if (currentPrecedence < precedence)
@@ -452,7 +979,16 @@ ASTNode *FileParser::parseUnary()
 {
 	Token tok = tokens[index];
 
-	if (tok.type == TOKEN_REFERENCE || tok.type == TOKEN_OPERATOR_NOT || tok.type == TOKEN_OPERATOR_MINUS || tok.type == TOKEN_POINTER)
+	// In prefix position && is a reference to a reference, as in &&x
+	if (tok.type == TOKEN_OPERATOR_AND)
+	{
+		index++;
+		Token outer = {TOKEN_REFERENCE, "&", tok.position};
+		Token inner = {TOKEN_REFERENCE, "&", {tok.position.row, tok.position.col + 1}};
+		return new UnaryExpr(outer, new UnaryExpr(inner, parseUnary()));
+	}
+
+	if (tok.type == TOKEN_REFERENCE || tok.type == TOKEN_OPERATOR_NOT || tok.type == TOKEN_OPERATOR_BIT_NOT || tok.type == TOKEN_OPERATOR_MINUS || tok.type == TOKEN_POINTER)
 	{
 		index++;
 		auto expr = parseUnary();
@@ -482,19 +1018,37 @@ ASTNode *FileParser::parsePrimary()
 		return parseSpecial();
 	case TOKEN_LEFT_PAREN:
 	{
+		bool allowed = allowStructLiteral;
+		allowStructLiteral = true;
 		auto expr = parseExpression();
+
+		// (a, b) is a tuple, (a) only groups
+		if (tokens[index].type == TOKEN_COMMA)
+		{
+			std::vector<ASTNode *> values = {expr};
+
+			while (tokens[index].type == TOKEN_COMMA)
+			{
+				index++;
+				values.push_back(parseExpression());
+			}
+
+			expr = new TupleLiteral(values);
+		}
+
+		allowStructLiteral = allowed;
 		expectConsume(TOKEN_RIGHT_PAREN, "Expected ) after parsing expression");
 		return expr;
 	}
 	case TOKEN_IDENTIFIER:
 	{
 		// Struct Literal with implicit module
-		if (tokens[index].type == TOKEN_LEFT_BRACE)
+		if (tokens[skipTypeArguments(index)].type == TOKEN_LEFT_BRACE && allowStructLiteral)
 		{
 			index--;
 			return parseStructLiteral(module);
 		}
-		else if (tokens[index].type == TOKEN_LEFT_PAREN) // Function call with implicit module
+		else if (tokens[skipTypeArguments(index)].type == TOKEN_LEFT_PAREN) // Function call with implicit module
 		{
 			index--;
 			return parseFunctionCall(module);
@@ -503,16 +1057,19 @@ ASTNode *FileParser::parsePrimary()
 		{
 			index++;
 			expectConsume(TOKEN_IDENTIFIER, "Expected struct or function name.");
-			if (tokens[index].type == TOKEN_LEFT_PAREN)
+			if (tokens[skipTypeArguments(index)].type == TOKEN_LEFT_PAREN)
 			{
 				index--;
 				return parseFunctionCall(cur.value);
 			}
-			else if (tokens[index].type == TOKEN_LEFT_BRACE)
+			else if (tokens[skipTypeArguments(index)].type == TOKEN_LEFT_BRACE && allowStructLiteral)
 			{
 				index--;
 				return parseStructLiteral(cur.value);
 			}
+
+			// module:Name.Variant, an enum of another module
+			cur.value += ":" + tokens[index - 1].value;
 		}
 
 		std::vector<ASTNode *> indexes;
@@ -522,10 +1079,24 @@ ASTNode *FileParser::parsePrimary()
 			switch (tokens[index].type)
 			{
 			case TOKEN_LEFT_SQUARE_BRACKET:
+			{
 				expectConsume(TOKEN_LEFT_SQUARE_BRACKET, "Expected left square bracket");
-				indexes.push_back(new ArrayIndex(parseExpression()));
+				ASTNode *start = tokens[index].type == TOKEN_RANGE ? nullptr : parseExpression();
+
+				if (tokens[index].type == TOKEN_RANGE)
+				{
+					index++;
+					ASTNode *end = tokens[index].type == TOKEN_RIGHT_SQUARE_BRACKET ? nullptr : parseExpression();
+					indexes.push_back(new SliceRange(start, end));
+				}
+				else
+				{
+					indexes.push_back(new ArrayIndex(start));
+				}
+
 				expectConsume(TOKEN_RIGHT_SQUARE_BRACKET, "Expected right square bracket");
 				break;
+			}
 			case TOKEN_DOT:
 				expectConsume(TOKEN_DOT, "");
 				indexes.push_back(new StructField(expectConsume(TOKEN_IDENTIFIER, "Expected Identifier").value));
@@ -563,6 +1134,7 @@ StructLiteral *FileParser::parseStructLiteral(std::string &module)
 {
 	auto moduleName = module;
 	auto name = expectConsume(TOKEN_IDENTIFIER, "Expected ident").value;
+	auto typeArgs = parseTypeArguments();
 
 	expectConsume(TOKEN_LEFT_BRACE, "Expected left square bracket");
 
@@ -581,7 +1153,10 @@ StructLiteral *FileParser::parseStructLiteral(std::string &module)
 
 	expectConsume(TOKEN_RIGHT_BRACE, "Expected left square bracket");
 
-	return new StructLiteral(moduleName, name, fieldNames, fieldExprs);
+	auto literal = new StructLiteral(moduleName, name, fieldNames, fieldExprs);
+	literal->typeArgs = typeArgs;
+
+	return literal;
 }
 
 ASTNode *FileParser::parseSpecial()
@@ -589,6 +1164,37 @@ ASTNode *FileParser::parseSpecial()
 	auto cur = tokens[index];
 	index++;
 
+	// @tail marks the call that follows it rather than taking arguments, as in return @tail f(x);
+	if (cur.value == "tail")
+	{
+		auto call = dynamic_cast<FunctionCall *>(parsePrimary());
+
+		if (!call)
+		{
+			FilePosition pos = cur.position;
+
+			std::cerr << path.string() << ":"
+					  << pos.row << ":" << pos.col
+					  << " > error: " << "Expected a function call after @tail"
+					  << std::endl;
+			exit(1);
+		}
+
+		call->mustTail = true;
+		return call;
+	}
+
+	if (cur.value == "asm")
+	{
+		FilePosition pos = cur.position;
+
+		std::cerr << path.string() << ":"
+				  << pos.row << ":" << pos.col
+				  << " > error: " << "@asm is a statement and has no value, read its results through output operands"
+				  << std::endl;
+		exit(1);
+	}
+
 	expectConsume(TOKEN_LEFT_PAREN, "Expected opening paren");
 
 	if (cur.value == "cast")
@@ -601,7 +1207,142 @@ ASTNode *FileParser::parseSpecial()
 		return new Cast(type, expr);
 	}
 
-	return nullptr;
+	Type *type = nullptr;
+
+	if (cur.value == "splat")
+	{
+		type = parseType();
+		expectConsume(TOKEN_COMMA, "Expected comma");
+	}
+	else if (!isBuiltin(cur.value))
+	{
+		FilePosition pos = cur.position;
+
+		std::cerr << path.string() << ":"
+				  << pos.row << ":" << pos.col
+				  << " > error: " << "Unknown builtin"
+				  << " Received: @" << cur.value
+				  << std::endl;
+		exit(1);
+	}
+
+	std::vector<ASTNode *> args;
+
+	while (tokens[index].type != TOKEN_RIGHT_PAREN)
+	{
+		args.push_back(parseExpression());
+
+		if (tokens[index].type != TOKEN_RIGHT_PAREN)
+			expectConsume(TOKEN_COMMA, "Expected comma between builtin arguments");
+	}
+
+	expectConsume(TOKEN_RIGHT_PAREN, "Expected closing paren");
+
+	return new Builtin(cur.value, type, args);
+}
+
+ASTNode *FileParser::parseAsm()
+{
+	std::string text = expectConsume(TOKEN_STRING_LITERAL, "Expected assembly template").value;
+	std::vector<std::pair<std::string, ASTNode *>> outputs, inputs;
+	std::vector<std::string> clobbers;
+
+	// Outputs, inputs and clobbers are each optional, but keep their order
+	if (tokens[index].type == TOKEN_COMMA)
+	{
+		index++;
+		outputs = parseAsmOperands();
+	}
+
+	if (tokens[index].type == TOKEN_COMMA)
+	{
+		index++;
+		inputs = parseAsmOperands();
+	}
+
+	if (tokens[index].type == TOKEN_COMMA)
+	{
+		index++;
+		expectConsume(TOKEN_LEFT_SQUARE_BRACKET, "Expected [ before clobbers");
+
+		while (tokens[index].type != TOKEN_RIGHT_SQUARE_BRACKET)
+		{
+			clobbers.push_back(expectConsume(TOKEN_STRING_LITERAL, "Expected clobbered register or memory").value);
+
+			if (tokens[index].type != TOKEN_RIGHT_SQUARE_BRACKET)
+				expectConsume(TOKEN_COMMA, "Expected comma between clobbers");
+		}
+
+		expectConsume(TOKEN_RIGHT_SQUARE_BRACKET, "Expected ] after clobbers");
+	}
+
+	expectConsume(TOKEN_RIGHT_PAREN, "Expected closing paren");
+
+	return new Asm(text, outputs, inputs, clobbers);
+}
+
+// ["constraint"(expr), ...]
+std::vector<std::pair<std::string, ASTNode *>> FileParser::parseAsmOperands()
+{
+	std::vector<std::pair<std::string, ASTNode *>> operands;
+
+	expectConsume(TOKEN_LEFT_SQUARE_BRACKET, "Expected [ before asm operands");
+
+	while (tokens[index].type != TOKEN_RIGHT_SQUARE_BRACKET)
+	{
+		std::string constraint = expectConsume(TOKEN_STRING_LITERAL, "Expected operand constraint").value;
+		expectConsume(TOKEN_LEFT_PAREN, "Expected ( after operand constraint");
+		operands.push_back({constraint, parseExpression()});
+		expectConsume(TOKEN_RIGHT_PAREN, "Expected ) after asm operand");
+
+		if (tokens[index].type != TOKEN_RIGHT_SQUARE_BRACKET)
+			expectConsume(TOKEN_COMMA, "Expected comma between asm operands");
+	}
+
+	expectConsume(TOKEN_RIGHT_SQUARE_BRACKET, "Expected ] after asm operands");
+
+	return operands;
+}
+
+bool FileParser::isBuiltin(std::string &name)
+{
+	std::vector<std::string> builtins = {
+		"splat",
+		"shuffle",
+		"extract",
+		"insert",
+		"select",
+		"reduce_add",
+		"reduce_mul",
+		"reduce_min",
+		"reduce_max",
+		"reduce_and",
+		"reduce_or",
+		"reduce_xor",
+		"likely",
+		"unlikely",
+		"assume",
+		"unreachable",
+		"prefetch",
+		"stream_store",
+		"popcount",
+		"ctz",
+		"clz",
+		"bswap",
+		"rotl",
+		"rotr",
+		"min",
+		"max",
+		"abs",
+		"add_sat",
+		"sub_sat",
+		"memcpy",
+		"memmove",
+		"memset",
+		"memcmp",
+		"len"};
+
+	return std::find(builtins.begin(), builtins.end(), name) != builtins.end();
 }
 
 Token FileParser::expectConsume(TokenType type, std::string errorMessage)
@@ -658,7 +1399,9 @@ void Parser::parse(std::filesystem::path p)
 {
 	// std::cout << "Beginning to parse: " << p << "\n";
 	Lexer lex(p);
-	lex.display(lex.tokens());
+
+	if (verbose)
+		lex.display(lex.tokens());
 
 	FileParser fileParser(lex.tokens(), p, this);
 	auto ast = fileParser.parse();
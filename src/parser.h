@@ -19,7 +19,7 @@ class GScope;
 static void indentPrint(int indent, const std::string &str)
 {
 	std::string indentStr(indent * 2, ' ');
-	std::cout << indentStr << str << std::endl;
+	std::cerr << indentStr << str << std::endl;
 }
 
 struct ASTNode
@@ -54,16 +54,25 @@ struct Block : public ASTNode
 	}
 };
 
+struct Directive
+{
+	std::string name;
+	std::vector<std::string> args;
+	FilePosition position;
+};
+
 struct Type : public ASTNode
 {
 	size_t pointerLevel;
 	std::string name;
+	bool isUnique = false; // ^unique T, the only pointer the function reaches this memory through
+	bool isConst = false;  // ^const T, the memory is only read through this pointer
 
 	Type(size_t pointerLevel, std::string name) : pointerLevel(pointerLevel), name(name) {}
 
 	void print(int level) override
 	{
-		indentPrint(level, "Type:");
+		indentPrint(level, std::string("Type:") + (isUnique ? " unique" : "") + (isConst ? " const" : ""));
 		indentPrint(level + 2, "Level: " + std::to_string(pointerLevel));
 		indentPrint(level + 2, "Name: " + name);
 	}
@@ -98,9 +107,55 @@ struct ArrayType : public Type
 	}
 };
 
+struct SliceType : public Type
+{
+	Type *type;
+
+	SliceType(Type *type, size_t pointerLevel) : Type(pointerLevel, ""), type(type) {}
+
+	void print(int level) override
+	{
+		indentPrint(level, "Slice Type:");
+		indentPrint(level + 2, "Level: " + std::to_string(pointerLevel));
+		type->print(level + 2);
+	}
+};
+
+struct VectorType : public Type
+{
+	Type *type;
+	int size;
+
+	VectorType(Type *type, int size, size_t pointerLevel) : Type(pointerLevel, ""), type(type), size(size) {}
+
+	void print(int level) override
+	{
+		indentPrint(level, "Vector Type:");
+		indentPrint(level + 2, "Level: " + std::to_string(pointerLevel));
+		indentPrint(level + 2, "Lanes: " + std::to_string(size));
+		type->print(level + 2);
+	}
+};
+
+struct TupleType : public Type
+{
+	std::vector<Type *> types;
+
+	TupleType(std::vector<Type *> types, size_t pointerLevel) : Type(pointerLevel, ""), types(types) {}
+
+	void print(int level) override
+	{
+		indentPrint(level, "Tuple Type:");
+		indentPrint(level + 2, "Level: " + std::to_string(pointerLevel));
+		for (auto type : types)
+			type->print(level + 2);
+	}
+};
+
 struct StructType : public Type
 {
 	std::string moduleName;
+	std::vector<Type *> typeArgs; // Name[T, U], an instance of a generic struct
 
 	StructType(std::string moduleName, std::string structName, size_t pointerLevel) : Type(pointerLevel, structName), moduleName(moduleName) {}
 
@@ -110,6 +165,8 @@ struct StructType : public Type
 		indentPrint(level + 2, "Level: " + std::to_string(pointerLevel));
 		indentPrint(level + 2, "Module: " + moduleName);
 		indentPrint(level + 2, "Name: " + name);
+		for (auto arg : typeArgs)
+			arg->print(level + 2);
 	}
 };
 
@@ -117,16 +174,27 @@ struct FunctionDefinition : public ASTNode
 {
 	std::string moduleName;
 	std::string name;
+	std::vector<std::string> typeParams; // [T, U], the body is generated once per distinct set of type arguments
 	std::vector<std::string> paramNames;
 	std::vector<Type *> paramTypes;
 	Type *returnType;
+	std::vector<Directive> attributes; // #inline, #cold, #optimize(size), ...
 
 	Block *body; // could be nullptr if no body
 
 	llvm::Value *codegen(GScope *scope, Generator *gen) override;
+	llvm::Value *define(llvm::Function *func, GScope *scope, Generator *gen);
 	void print(int level) override
 	{
 		indentPrint(level, "Function: " + name);
+		for (auto &typeParam : typeParams)
+		{
+			indentPrint(level + 1, "Type Parameter: " + typeParam);
+		}
+		for (auto &attribute : attributes)
+		{
+			indentPrint(level + 1, "Attribute: #" + attribute.name);
+		}
 		indentPrint(level + 1, "Return Type:");
 		returnType->print(level + 2);
 		indentPrint(level + 1, "Parameters:");
@@ -149,11 +217,17 @@ struct FunctionCall : public ASTNode
 	std::string moduleName;
 	std::string name;
 	std::vector<ASTNode *> params;
+	std::vector<Type *> typeArgs; // f[T](...), a generic callee otherwise infers them from the arguments
+	bool mustTail = false; // written as @tail f(...), must be emitted as a guaranteed tail call
 
 	llvm::Value *codegen(GScope *scope, Generator *gen) override;
 	void print(int level) override
 	{
-		indentPrint(level, "Function Call: " + name);
+		indentPrint(level, std::string(mustTail ? "Tail " : "") + "Function Call: " + name);
+		for (auto arg : typeArgs)
+		{
+			arg->print(level + 1);
+		}
 		indentPrint(level + 1, "Parameters:");
 		for (auto param : params)
 		{
@@ -168,6 +242,7 @@ struct StructDefinition : public ASTNode
 	std::string moduleName;
 	std::vector<std::string> fieldNames;
 	std::vector<Type *> fieldTypes;
+	std::vector<std::string> typeParams; // [T, U], a type is created per distinct set of type arguments
 
 	// llvm::Value* codegen(GScope *scope, Generator *gen) override;
 	StructDefinition(std::string name, std::string moduleName, std::vector<std::string> fieldNames, std::vector<Type *> fieldTypes) : name(name), moduleName(moduleName), fieldNames(fieldNames), fieldTypes(fieldTypes) {}
@@ -176,6 +251,9 @@ struct StructDefinition : public ASTNode
 	{
 		indentPrint(level, "Struct Decl: " + name);
 
+		for (auto &typeParam : typeParams)
+			indentPrint(level + 2, "Type Parameter: " + typeParam);
+
 		for (size_t i = 0; i < fieldNames.size(); ++i)
 		{
 			indentPrint(level + 2, "Field name: " + fieldNames[i]);
@@ -184,6 +262,48 @@ struct StructDefinition : public ASTNode
 	}
 };
 
+// An integer backed enum, variants without a value follow the previous one
+struct EnumDefinition : public ASTNode
+{
+	std::string name;
+	std::string moduleName;
+	Type *type;
+	std::vector<std::string> variantNames;
+	std::vector<int64_t> values;
+
+	EnumDefinition(std::string name, std::string moduleName, Type *type, std::vector<std::string> variantNames, std::vector<int64_t> values)
+		: name(name), moduleName(moduleName), type(type), variantNames(variantNames), values(values) {}
+
+	void print(int level) override
+	{
+		indentPrint(level, "Enum Decl: " + name);
+		type->print(level + 2);
+
+		for (size_t i = 0; i < variantNames.size(); ++i)
+			indentPrint(level + 2, "Variant: " + variantNames[i] + " = " + std::to_string(values[i]));
+	}
+};
+
+// A module level variable, const ones are placed in read only memory and uninitialized ones are zeroed
+struct GlobalDecl : public ASTNode
+{
+	std::string varName;
+	Type *type;
+	ASTNode *expr; // nullptr when zero initialized
+	bool isConstant;
+
+	llvm::Value *codegen(GScope *scope, Generator *gen) override;
+	GlobalDecl(const std::string &varName, Type *type, ASTNode *expr, bool isConstant) : varName(varName), type(type), expr(expr), isConstant(isConstant) {}
+
+	void print(int level) override
+	{
+		indentPrint(level, std::string(isConstant ? "Const" : "Global") + " Decl: " + varName);
+		type->print(level + 2);
+		if (expr)
+			expr->print(level + 2);
+	}
+};
+
 struct Return : public ASTNode
 {
 	ASTNode *expr;
@@ -289,6 +409,7 @@ struct StructLiteral : public ASTNode
 	std::string name;
 	std::vector<std::string> fieldNames;
 	std::vector<ASTNode *> fieldExprs;
+	std::vector<Type *> typeArgs; // Name[T]{...}, otherwise taken from the declared type or the field values
 
 	llvm::Value *codegen(GScope *scope, Generator *gen) override;
 	StructLiteral(std::string moduleName, std::string name, std::vector<std::string> fieldNames, std::vector<ASTNode *> fieldExprs) : moduleName(moduleName), name(name), fieldNames(fieldNames), fieldExprs(fieldExprs) {}
@@ -331,23 +452,74 @@ struct ArrayIndex : public ASTNode
 	}
 };
 
+struct SliceRange : public ASTNode
+{
+	ASTNode *start; // nullptr for the start of the sequence
+	ASTNode *end;	// nullptr for the end of the sequence
+
+	SliceRange(ASTNode *start, ASTNode *end) : start(start), end(end) {}
+	void print(int level) override
+	{
+		indentPrint(level, "Slice Range: ");
+		if (start)
+			start->print(level + 2);
+		if (end)
+			end->print(level + 2);
+	}
+};
+
 struct VariableDecl : public ASTNode
 {
 	std::string varName;
 	Type *type;
 	ASTNode *expr;
+	bool isMutable; // let mut, a plain let cannot be assigned after its declaration
 
 	llvm::Value *codegen(GScope *scope, Generator *gen) override;
-	VariableDecl(const std::string &varName, Type *type, ASTNode *expr) : varName(varName), type(type), expr(expr) {}
+	VariableDecl(const std::string &varName, Type *type, ASTNode *expr, bool isMutable) : varName(varName), type(type), expr(expr), isMutable(isMutable) {}
 
 	void print(int level) override
 	{
-		indentPrint(level, "Variable Decl: " + varName);
+		indentPrint(level, std::string("Variable Decl: ") + (isMutable ? "mut " : "") + varName);
 		type->print(level + 2);
 		expr->print(level + 2);
 	}
 };
 
+// let (q, r) = divmod(a, b);
+struct Destructure : public ASTNode
+{
+	std::vector<std::string> names; // _ discards its element
+	ASTNode *expr;
+	bool isMutable;
+
+	llvm::Value *codegen(GScope *scope, Generator *gen) override;
+	Destructure(std::vector<std::string> names, ASTNode *expr, bool isMutable) : names(names), expr(expr), isMutable(isMutable) {}
+
+	void print(int level) override
+	{
+		std::string list;
+		for (auto &name : names)
+			list += (list.empty() ? "" : ", ") + name;
+		indentPrint(level, std::string("Destructure: ") + (isMutable ? "mut " : "") + "(" + list + ")");
+		expr->print(level + 2);
+	}
+};
+
+struct TupleLiteral : public ASTNode
+{
+	std::vector<ASTNode *> values;
+
+	llvm::Value *codegen(GScope *scope, Generator *gen) override;
+	TupleLiteral(std::vector<ASTNode *> values) : values(values) {}
+	void print(int level) override
+	{
+		indentPrint(level, "Tuple Literal:");
+		for (auto value : values)
+			value->print(level + 2);
+	}
+};
+
 struct IntLiteral : public ASTNode
 {
 	int value;
@@ -420,6 +592,56 @@ struct Cast : public ASTNode
 	}
 };
 
+struct Builtin : public ASTNode
+{
+	std::string name;
+	Type *type; // explicit type operand, e.g. @splat(vec[f32; 8], x), nullptr if none
+	std::vector<ASTNode *> args;
+
+	llvm::Value *codegen(GScope *scope, Generator *gen) override;
+	Builtin(std::string name, Type *type, std::vector<ASTNode *> args)
+		: name(name), type(type), args(args) {}
+	void print(int level) override
+	{
+		indentPrint(level, "Builtin: @" + name);
+		if (type)
+			type->print(level + 2);
+		for (auto &arg : args)
+		{
+			arg->print(level + 2);
+		}
+	}
+};
+
+// @asm("template", ["=r"(out)], ["r"(in)], ["memory"]), operands are $0, $1, ... outputs first
+struct Asm : public ASTNode
+{
+	std::string text;
+	std::vector<std::pair<std::string, ASTNode *>> outputs; // constraint and the lvalue written
+	std::vector<std::pair<std::string, ASTNode *>> inputs;
+	std::vector<std::string> clobbers;
+
+	llvm::Value *codegen(GScope *scope, Generator *gen) override;
+	Asm(std::string text, std::vector<std::pair<std::string, ASTNode *>> outputs, std::vector<std::pair<std::string, ASTNode *>> inputs, std::vector<std::string> clobbers)
+		: text(text), outputs(outputs), inputs(inputs), clobbers(clobbers) {}
+	void print(int level) override
+	{
+		indentPrint(level, "Asm: " + text);
+		for (auto &output : outputs)
+		{
+			indentPrint(level + 2, "Output: " + output.first);
+			output.second->print(level + 4);
+		}
+		for (auto &input : inputs)
+		{
+			indentPrint(level + 2, "Input: " + input.first);
+			input.second->print(level + 4);
+		}
+		for (auto &clobber : clobbers)
+			indentPrint(level + 2, "Clobber: " + clobber);
+	}
+};
+
 struct While : public ASTNode
 {
 	ASTNode *condition;
@@ -436,6 +658,58 @@ struct While : public ASTNode
 	}
 };
 
+struct For : public ASTNode
+{
+	std::string varName;
+	Type *type; // induction variable type, nullptr to take the width of the bounds
+	ASTNode *start;
+	ASTNode *end;
+	Block *body;
+	std::vector<Directive> hints;
+
+	llvm::Value *codegen(GScope *scope, Generator *gen) override;
+	For(std::string varName, Type *type, ASTNode *start, ASTNode *end, Block *body, std::vector<Directive> hints)
+		: varName(varName), type(type), start(start), end(end), body(body), hints(hints) {}
+
+	void print(int level) override
+	{
+		indentPrint(level, "For: " + varName);
+		for (auto &hint : hints)
+		{
+			indentPrint(level + 2, "Hint: #" + hint.name);
+		}
+		start->print(level + 2);
+		end->print(level + 2);
+		body->print(level + 2);
+	}
+};
+
+// A multi-way branch on an integer or enum, lowered to a switch instruction
+struct Match : public ASTNode
+{
+	ASTNode *value;
+	std::vector<std::pair<std::vector<ASTNode *>, Block *>> arms; // constant patterns and block, no patterns for the else arm
+
+	llvm::Value *codegen(GScope *scope, Generator *gen) override;
+	Match(ASTNode *value, std::vector<std::pair<std::vector<ASTNode *>, Block *>> arms) : value(value), arms(arms) {}
+
+	void print(int level) override
+	{
+		indentPrint(level, "Match: ");
+		value->print(level + 2);
+
+		for (auto &arm : arms)
+		{
+			indentPrint(level, arm.first.empty() ? "Else: " : "Patterns: ");
+
+			for (auto pattern : arm.first)
+				pattern->print(level + 2);
+
+			arm.second->print(level + 2);
+		}
+	}
+};
+
 struct Conditional : public ASTNode
 {
 	std::vector<std::pair<ASTNode *, Block *>> conditions; // condition and block
@@ -478,7 +752,7 @@ struct FileInfo
 class Parser
 {
 public:
-	Parser(std::filesystem::path path, std::filesystem::path compilerPath);
+	Parser(std::filesystem::path path, std::filesystem::path compilerPath, bool verbose = false);
 
 	void parse(std::filesystem::path path);
 	bool isParsed(std::filesystem::path path);
@@ -487,6 +761,7 @@ public:
 	std::set<std::filesystem::path> parsedFiles;
 	std::map<std::filesystem::path, std::string> pathToModule;
 	std::filesystem::path compilerPath;
+	bool verbose; // dump the tokens and syntax tree of every file to stderr
 };
 
 class FileParser
@@ -504,8 +779,10 @@ private:
 	Token expectConsume(TokenType type, std::string errorMessage);
 	std::filesystem::path resolveImportPath(std::filesystem::path p);
 	bool isBuiltInType(std::string &t);
+	bool isBuiltin(std::string &name);
 
 	size_t index;
+	bool allowStructLiteral = true; // false while parsing a condition that is followed by a block
 	std::vector<Token> tokens;
 	std::filesystem::path path;
 	std::filesystem::path baseDir;
@@ -517,16 +794,29 @@ private:
 	ASTNode *parseUnary();
 	ASTNode *parsePrimary();
 	ASTNode *parseSpecial();
+	ASTNode *parseAsm();
+	Destructure *parseDestructure();
+	std::vector<std::pair<std::string, ASTNode *>> parseAsmOperands();
 	FunctionDefinition *parseFunction();
+	void checkFunctionAttributes(std::vector<Directive> &attributes);
 	StructDefinition *parseStruct();
+	GlobalDecl *parseGlobalDecl();
+	EnumDefinition *parseEnum();
+	Match *parseMatch();
 	Assign *parseAssign();
 	Conditional *parseConditional();
 	Block *parseBlock();
 	While *parseWhile();
+	For *parseFor(std::vector<Directive> hints);
+	std::vector<Directive> parseDirectives();
 	FunctionCall *parseFunctionCall(std::string &moduleName);
 	StructLiteral *parseStructLiteral(std::string &moduleName);
 	VariableDecl *parseVariableDecl();
 	Type *parseType();
+	Type *parseTypeName(Type *t);
+	std::vector<std::string> parseTypeParameters();
+	std::vector<Type *> parseTypeArguments();
+	size_t skipTypeArguments(size_t at);
 };
 
 #endif